@@ -2,27 +2,136 @@
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
 #include "hardware/i2c.h"
+#include "hardware/watchdog.h"
+#include "hardware/uart.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "pico/unique_id.h"
 #include "pico/time.h"
 
+#include "cycle_stats.h"
+#include "cycle_log.h"
+#include "control.h"
+#include "oven_profile.h"
+#include "power_bus.h"
+#include "relay_control.h"
+#include "status_snapshot.h"
+#include "time_sync.h"
+#include "timer_wheel.h"
+#if USB_MSC_EXPORT
+#include "usb_export.h"
+#endif
+
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
 #include <math.h>
 
-// Settings
+// Settings. Product limits, pins and increments come from oven_profile.h.
 #define SCREEN_TIMEOUT  30000
-#define TOAST_TIME_INC  15
-#define BAKE_TIME_INC   30
-#define BAKE_TEMP_INC   25
 #define LOOP_DELAY_MS   20
-#define TEMP_HYSTERESIS 2.5
 #define LONG_PRESS_MS   200
+// The control loop must re-assert the relay at least this often or the
+// dead-man alarm switches the element off on its own.
+#define RELAY_DEADMAN_MS 1000
 // LCD update interval (ms) to avoid blocking the main loop too long
 #define LCD_UPDATE_MS   200
+#define SPI_BAUD        4000000
 
+// Fastest useful sensor read rate (MAX6675 conversion time). Sensors that
+// convert faster can lower this; the adaptive rates below never go under it.
 #define MIN_TEMP_REFRESH_US 220000
 
+// Adaptive sampling: slow down when nothing depends on the reading, run at
+// the sensor ceiling when close to the setpoint or when temperature moves fast.
+#define TEMP_REFRESH_SLEEP_US 5000000 // idle with the screen off
+#define TEMP_REFRESH_IDLE_US  1000000 // idle with the screen on
+#define TEMP_REFRESH_RUN_US   500000  // running, far from setpoint and slow
+#define TEMP_FAST_BAND_C      10.0f   // |error| below this samples at full rate
+#define TEMP_FAST_RATE_C_PER_S 1.0f   // |dT/dt| above this samples at full rate
+#define TEMP_RATE_FILTER_S    2.0f    // time constant of the dT/dt filter
+
+// Relay controller at boot; the USB "ctrl" command switches it. The
+// adaptive band learns this oven's lag over the first few relay cycles.
+// Cascade needs the element thermocouple and falls back to the fixed band
+// whenever that sensor isn't reading.
+#define CONTROL_MODE_DEFAULT (ELEMENT_SENSOR ? CONTROL_CASCADE : CONTROL_FIXED_BAND)
+// Ambient assumed by the MPC's thermal model
+#define MODEL_AMBIENT_C 25.0f
+
+// Sensor plausibility limits. A real oven cannot move the probe faster than
+// this, and a reading that stays frozen while the element is on is a probe
+// that has come loose from the cavity (or a latched-up converter).
+#define TEMP_MAX_RATE_C_PER_S 25.0f
+#define TEMP_STUCK_MS         60000
+
 #define ACTION_BEEP_LENGTH   50
 #define START_BEEP_LENGTH    200 
 #define COMPLETE_BEEP_LENGTH 500
+#define COMPLETE_BEEP_COUNT  3
+
+// Power-fail resume. A running cycle is checkpointed to flash as it starts
+// and on stage changes (no more than once per CHECKPOINT_MIN_MS), and this
+// often while the timer counts down. On the first boot after an outage it is
+// offered for resume if the cavity has not cooled much.
+#define CHECKPOINT_PERIOD_MS 15000
+#define CHECKPOINT_MIN_MS    2000
+#define RESUME_MIN_TEMP_C    60
+#define RESUME_MAX_DROP_C    25
+#define RESUME_PROMPT_MS     30000
+
+// I2C bus speed. The fastest rate that passes the boot probe is used, and
+// repeated write errors at runtime step down to the next slower one.
+#define I2C_TIMEOUT_US      2000
+#define I2C_PROBE_ROUNDS    16
+#define I2C_FALLBACK_ERRORS 3
+
+// Boot self-benchmark. Runs when built with SELF_BENCHMARK=1 or when DOWN
+// is held during power-up.
+#ifndef SELF_BENCHMARK
+#define SELF_BENCHMARK 0
+#endif
+#define BENCH_I2C_WRITES  64
+#define BENCH_SPI_READS   16
+#define BENCH_LCD_FRAMES  3
+#define BENCH_LOOP_PASSES 50 // Idle main loop passes timed after the rest
+
+// Post-cycle statistics screen
+#define STATS_PAGE_MS   2500
+// Presets: with START held, tapping MODE, UP or DOWN recalls slot 1-3 and
+// holding it this long saves the current settings there instead
+#define PRESET_SLOTS    3
+#define PRESET_SAVE_MS  1500
+// Flash sectors holding the cycle log (64 records each)
+#define CYCLE_LOG_SECTORS 8
+// USB drive exposing the cycle log as files. Set by the USB_MSC_EXPORT CMake option.
+#ifndef USB_MSC_EXPORT
+#define USB_MSC_EXPORT 0
+#endif
+
+// Watchdog supervision. The hardware watchdog is only fed while every task
+// has checked in within its own deadline.
+#define WATCHDOG_TIMEOUT_MS    2000
+#define SUPERVISOR_PERIOD_MS   100
+#define CONTROL_DEADLINE_MS    1000
+#define SENSOR_DEADLINE_MS     (TEMP_REFRESH_SLEEP_US / 1000 + 2500)
+#define DISPLAY_DEADLINE_MS    1000
+#define USB_DEADLINE_MS        1000
+
+// Controller board protection from the RP2040's own temperature sensor.
+// Above WARN the board is derated (slower clock and LCD, capped element
+// duty); above SHUTDOWN the element is latched off like a sensor fault.
+#define BOARD_TEMP_PERIOD_MS    1000
+#define BOARD_TEMP_WARN_C       70.0f
+#define BOARD_TEMP_SHUTDOWN_C   85.0f
+#define BOARD_TEMP_HYSTERESIS_C 5.0f
+#define BOARD_DERATE_SYS_KHZ    48000
+#define BOARD_DERATE_LCD_MS     1000
+#define BOARD_DERATE_WINDOW_MS  10000
+#define BOARD_DERATE_DUTY_PCT   50
 
 // Debug prints (set to 1 to enable). Keep disabled by default to avoid
 // expensive blocking stdio calls in tight loops.
@@ -36,10 +145,11 @@
 /* --- Global configuration and state --- */
 static const char* const modes[] = {"     Toast      ", "      Bake      ", "    Passthru    "};
 static const char* const running_modes[] = {"  Toasting...   ", "   Baking...    ", "    Passthru    "};
+static const char* const resume_prompts[] = {" Resume toast?  ", "  Resume bake?  ", "Resume passthru?"};
 
-static int toast_time = 10; // seconds
-static int bake_time = 300;  // seconds
-static int bake_temp = 82;  // Fahrenheit
+static int toast_time = TOAST_TIME_DEFAULT; // seconds
+static int bake_time = BAKE_TIME_DEFAULT;   // seconds
+static int bake_temp = BAKE_TEMP_DEFAULT;   // Fahrenheit
 
 /**
  * 0: Preheating
@@ -52,29 +162,13 @@ static uint8_t prev_heating_stage = 0;
 static absolute_time_t start_time;
 static int time_target = 0; // In milliseconds
 static int temp_target = 0; // Celsius
-static absolute_time_t last_lcd_update;
 static int last_display_seconds = -1;
 
-// SPI Defines
+// Bus instances; the pins are set by the oven profile
 #define SPI_PORT spi1
-#define PIN_MISO 12
-#define PIN_CS   13
-#define PIN_SCK  10
-#define PIN_MOSI 11
-
-// I2C defines
 #define I2C_PORT i2c0
-#define I2C_SDA 4
-#define I2C_SCL 5
-
-#define PIN_RELAY 7
-
-#define PIN_BTN_MODE  16
-#define PIN_BTN_UP    17
-#define PIN_BTN_DOWN  18
-#define PIN_BTN_START 19
-
-#define PIN_BUZZER 20
+#define BUS_UART uart0
+#define BUS_BAUD 115200
 
 // LCD constants
 enum {
@@ -115,37 +209,504 @@ static int lcd_addr = 0x27; // default I2C addr
 #define MAX_CHARS      16
 
 static float current_temp = -1;
-static absolute_time_t last_temp_check = 0;
+static float temp_rate = 0; // Filtered dT/dt in C/s
+static absolute_time_t temp_sample_time = 0;
+
+// Sensor reads and elapsed time, split by [idle, running]
+static uint32_t sensor_reads[2];
+static uint64_t sensor_time_us[2];
 
 /**
- * Updates the current temperature
- * @returns Whether the temperature was update (Irrespective of whether it was changed)
+ * Sensor fault codes, shown on screen as "E<n>".
+ * Any fault forces the relay off and latches until acknowledged with START.
+ */
+typedef enum SensorFault {
+    SENSOR_OK = 0,
+    SENSOR_FAULT_OPEN,  // MAX6675 reports an open thermocouple input
+    SENSOR_FAULT_BUS,   // SPI frame is all-ones or has fixed bits set
+    SENSOR_FAULT_RATE,  // Temperature moved faster than the oven physically can
+    SENSOR_FAULT_STUCK, // Reading frozen while the element is heating
+    SENSOR_FAULT_BOARD_HOT, // Controller die above BOARD_TEMP_SHUTDOWN_C
+} SensorFault;
+
+static const char* const sensor_fault_names[] = {"OK", "Open probe", "SPI bus", "Rate jump", "Stuck value", "Board too hot"};
+
+static SensorFault sensor_fault = SENSOR_OK;
+static volatile bool relay_on = false;
+static bool heat_demand = false; // Controller output, before the fault and power-budget gates
+static ControlMode control_mode;
+static RelayControl relay_control;
+static uint32_t mpc_step_us = 0;     // Planning time of the last quantum
+static uint32_t mpc_step_max_us = 0;
+static float element_temp = NAN; // NAN unless the element sensor is fitted and reading
+
+/* --- Event log --- */
+typedef struct LogEntry {
+    uint32_t time_ms;
+    uint8_t code;
+    int16_t value;
+} LogEntry;
+
+enum {
+    LOG_SENSOR_FAULT = 1,
+    LOG_RELAY_DEADMAN,
+    LOG_WATCHDOG_RESET,
+    LOG_I2C_FALLBACK,
+    LOG_BOARD_TEMP,
+    LOG_ELEMENT_SENSOR,
+    LOG_CHECKPOINT_FULL,
+};
+
+#define LOG_SIZE 32
+static LogEntry event_log[LOG_SIZE];
+static uint32_t event_log_count = 0;
+
+/* --- Wall clock --- */
+// Set from host pings over USB; see time_sync.h for the protocol
+static TimeSync time_sync;
+
+/**
+ * @returns Unix time in milliseconds at `local_ms` since boot, or -1 if the
+ * host hasn't synced us yet
+ */
+static int64_t wall_time_ms(uint32_t local_ms) {
+    int64_t wall_us;
+    if (!time_sync_wall_us(&time_sync, (uint64_t)local_ms * 1000, &wall_us)) return -1;
+    return wall_us / 1000;
+}
+
+static void print_event(const LogEntry *e) {
+    printf("EVT %lu %u %d %lld\n", (unsigned long)e->time_ms, e->code, e->value, (long long)wall_time_ms(e->time_ms));
+}
+
+static void log_event(uint8_t code, int16_t value) {
+    LogEntry *e = &event_log[event_log_count++ % LOG_SIZE];
+    e->time_ms = to_ms_since_boot(get_absolute_time());
+    e->code = code;
+    e->value = value;
+    print_event(e);
+}
+
+/* --- Task supervision --- */
+typedef enum Task {
+    TASK_CONTROL,
+    TASK_SENSOR,
+    TASK_DISPLAY,
+    TASK_USB,
+    TASK_COUNT
+} Task;
+
+static const char* const task_names[TASK_COUNT] = {"control", "sensor", "display", "usb"};
+static const uint32_t task_deadline_ms[TASK_COUNT] = {
+    CONTROL_DEADLINE_MS, SENSOR_DEADLINE_MS, DISPLAY_DEADLINE_MS, USB_DEADLINE_MS
+};
+
+// Watchdog scratch registers survive the reset; 4-7 are used by the SDK
+#define SUPERVISOR_MAGIC      0x5afe0000u
+#define SUPERVISOR_SCRATCH    0
+#define SUPERVISOR_LAST_TASK  1
+#define SUPERVISOR_STATE      2 // Control state when the supervisor gave up, two words
+
+static volatile uint32_t task_heartbeat_ms[TASK_COUNT];
+static repeating_timer_t supervisor_timer;
+static uint32_t supervisor_missed = 0; // Missed task mask recorded before the last reset
+static ControlStatus supervisor_state;  // Control state recorded before the last reset
+static bool supervisor_state_valid = false;
+
+// Control state as of the end of the last loop pass, for readers outside it
+static StatusSnapshot control_status;
+
+static inline void heartbeat(Task task) {
+    task_heartbeat_ms[task] = to_ms_since_boot(get_absolute_time());
+    watchdog_hw->scratch[SUPERVISOR_LAST_TASK] = task;
+}
+
+/*
+ * Runs from the timer IRQ so a wedged main loop cannot keep feeding the
+ * watchdog. Once a task is late the missed mask is written to a scratch
+ * register and the watchdog is left to expire.
  */
-static bool update_temp() {
-    if (!is_nil_time(last_temp_check) && absolute_time_diff_us(last_temp_check, get_absolute_time()) < MIN_TEMP_REFRESH_US) {
+static bool supervisor_callback(repeating_timer_t *rt) {
+    (void)rt;
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    uint32_t missed = 0;
+    for (int i = 0; i < TASK_COUNT; i++) {
+        if (now - task_heartbeat_ms[i] > task_deadline_ms[i]) missed |= 1u << i;
+    }
+
+    if (missed) {
+        // Keep what the loop was doing for the post-mortem. This IRQ may
+        // have cut into a publish, in which case there's no state to keep.
+        ControlStatus state;
+        if (status_snapshot_read(&control_status, &state, 1)) {
+            watchdog_hw->scratch[SUPERVISOR_STATE] = (uint32_t)(int32_t)(state.temp * 4) << 16 | (uint32_t)state.stage << 8 | state.flags;
+            watchdog_hw->scratch[SUPERVISOR_STATE + 1] = (uint32_t)state.time_target_ms;
+            missed |= 0x8000u;
+        }
+        watchdog_hw->scratch[SUPERVISOR_SCRATCH] = SUPERVISOR_MAGIC | missed;
         return false;
     }
-    uint8_t buffer[2];
+    watchdog_update();
+    return true;
+}
+
+static void init_supervisor(void) {
+    if (watchdog_caused_reboot() && (watchdog_hw->scratch[SUPERVISOR_SCRATCH] & 0xffff0000u) == SUPERVISOR_MAGIC) {
+        supervisor_missed = watchdog_hw->scratch[SUPERVISOR_SCRATCH] & 0x7fffu;
+        if (watchdog_hw->scratch[SUPERVISOR_SCRATCH] & 0x8000u) {
+            uint32_t packed = watchdog_hw->scratch[SUPERVISOR_STATE];
+            supervisor_state.temp = (int16_t)(packed >> 16) / 4.0f;
+            supervisor_state.stage = (uint8_t)(packed >> 8);
+            supervisor_state.flags = (uint8_t)packed;
+            supervisor_state.time_target_ms = (int32_t)watchdog_hw->scratch[SUPERVISOR_STATE + 1];
+            supervisor_state_valid = true;
+        }
+        log_event(LOG_WATCHDOG_RESET, (int16_t)supervisor_missed);
+    }
+    watchdog_hw->scratch[SUPERVISOR_SCRATCH] = 0;
+    status_snapshot_init(&control_status);
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    for (int i = 0; i < TASK_COUNT; i++) task_heartbeat_ms[i] = now;
+
+    watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+    add_repeating_timer_ms(SUPERVISOR_PERIOD_MS, supervisor_callback, NULL, &supervisor_timer);
+}
+
+static void print_supervisor_status(void) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    for (int i = 0; i < TASK_COUNT; i++) {
+        printf("TASK %s %lums/%lums\n", task_names[i], (unsigned long)(now - task_heartbeat_ms[i]), (unsigned long)task_deadline_ms[i]);
+    }
+    if (supervisor_missed) {
+        printf("WDT last reset missed:");
+        for (int i = 0; i < TASK_COUNT; i++) {
+            if (supervisor_missed & (1u << i)) printf(" %s", task_names[i]);
+        }
+        printf("\n");
+    }
+    if (supervisor_state_valid) {
+        printf("WDT last state %.2fC stage %u %ldms%s%s\n", supervisor_state.temp, supervisor_state.stage,
+               (long)supervisor_state.time_target_ms,
+               supervisor_state.flags & CONTROL_STATUS_RUNNING ? " running" : "",
+               supervisor_state.flags & CONTROL_STATUS_RELAY ? " relay" : "");
+    }
+
+    ControlStatus state;
+    if (status_snapshot_read(&control_status, &state, 3)) {
+        printf("CTRL %.2fC target %dC stage %u %ldms%s%s\n", state.temp, state.temp_target, state.stage,
+               (long)state.time_target_ms,
+               state.flags & CONTROL_STATUS_RUNNING ? " running" : "",
+               state.flags & CONTROL_STATUS_RELAY ? " relay" : "");
+    }
+}
+
+/* Publishes this pass's control state; the main loop is the only writer */
+static void publish_control_status(bool running) {
+    ControlStatus state = {
+        .temp = current_temp,
+        .time_target_ms = time_target,
+        .temp_target = (int16_t)temp_target,
+        .stage = heating_stage,
+        .flags = (running ? CONTROL_STATUS_RUNNING : 0) | (relay_on ? CONTROL_STATUS_RELAY : 0),
+    };
+    status_snapshot_publish(&control_status, &state);
+}
+
+/* --- Software timers --- */
+// Every software timeout is an entry on one wheel (timer_wheel.h) behind one
+// hardware alarm, armed for the wheel's next deadline. The alarm only wakes
+// the core; callbacks run from timers_wait in the main loop's context, so
+// they can touch anything the loop does. The relay dead-man and the
+// supervisor keep their own interrupts, since they must fire while the loop
+// is stuck.
+static TimerWheel timers;
+static int timer_alarm;
+static volatile bool timer_alarm_fired = false;
+static uint32_t timer_wakes = 0;
+static uint32_t timer_latency_us = 0;  // From a deadline to its callbacks running
+static uint32_t timer_latency_max_us = 0;
+
+static void timer_alarm_irq(uint alarm_num) {
+    (void)alarm_num;
+    timer_alarm_fired = true;
+    __sev();
+}
+
+static inline uint32_t timer_now_ms(void) { return to_ms_since_boot(get_absolute_time()); }
 
-    gpio_put(PIN_CS, 0);
+static void init_timers(void) {
+    timer_wheel_init(&timers, timer_now_ms());
+    timer_alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(timer_alarm, timer_alarm_irq);
+}
+
+/* Starts or restarts a timer; a period of 0 makes it a one-shot */
+static inline void timer_start(TimerWheelEntry *e, uint32_t delay_ms, uint32_t period_ms, TimerWheelCallback callback,
+                               void *arg) {
+    timer_wheel_start(&timers, e, timer_now_ms(), delay_ms, period_ms, callback, arg);
+}
+
+/* Starts a one-shot that runs no earlier than t, for deadlines finer than a millisecond */
+static void timer_start_at(TimerWheelEntry *e, absolute_time_t t, TimerWheelCallback callback, void *arg) {
+    uint32_t now_ms = timer_now_ms();
+    uint32_t at_ms = (uint32_t)((to_us_since_boot(t) + 999) / 1000);
+    uint32_t delay_ms = (int32_t)(at_ms - now_ms) > 0 ? at_ms - now_ms : 0;
+    timer_wheel_start(&timers, e, now_ms, delay_ms, 0, callback, arg);
+}
+
+static inline void timer_cancel(TimerWheelEntry *e) { timer_wheel_cancel(&timers, e); }
+
+/* Sleeps until the wheel's next deadline, then runs everything that is due */
+static void timers_wait(void) {
+    uint32_t at_ms;
+    if (!timer_wheel_next(&timers, &at_ms)) return;
+
+    // The wheel counts in 32-bit milliseconds; widen its deadline for the alarm
+    int64_t now_ms = (int64_t)(time_us_64() / 1000);
+    uint64_t due_us = (uint64_t)(now_ms + (int32_t)(at_ms - (uint32_t)now_ms)) * 1000;
+    timer_alarm_fired = false;
+    // A deadline already passed reports as missed and doesn't arm the alarm
+    if (!hardware_alarm_set_target(timer_alarm, from_us_since_boot(due_us))) {
+        while (!timer_alarm_fired) {
+#if USB_MSC_EXPORT
+            // The USB IRQ ends each WFE, so transfers are serviced as they arrive
+            usb_export_task();
+#endif
+            __wfe();
+        }
+    }
+
+    timer_latency_us = (uint32_t)(time_us_64() - due_us);
+    timer_latency_max_us = MAX(timer_latency_max_us, timer_latency_us);
+    timer_wakes++;
+    timer_wheel_run(&timers, timer_now_ms());
+}
+
+static void print_timer_status(void) {
+    printf("TIMERS active %lu fired %lu cascaded %lu wakes %lu, latency %lu us max %lu us\n",
+           (unsigned long)timers.active, (unsigned long)timers.fired, (unsigned long)timers.cascaded,
+           (unsigned long)timer_wakes, (unsigned long)timer_latency_us, (unsigned long)timer_latency_max_us);
+}
+
+/* --- Relay control --- */
+static int relay_deadman_alarm = -1;
+static volatile uint32_t relay_deadman_trips = 0;
+static uint32_t relay_deadman_logged = 0;
+
+/*
+ * Runs from the timer IRQ, so it still fires if the main loop is wedged in
+ * a blocking I2C transfer or sleep.
+ */
+static void relay_deadman_fired(uint alarm_num) {
+    (void)alarm_num;
+    gpio_put(PIN_RELAY, 0);
+    relay_on = false;
+    relay_deadman_trips++;
+}
+
+// All relay writes go through here so a latched sensor fault can never be
+// overridden by the controller. Every call while on re-arms the dead-man.
+static void relay_set(bool on) {
+    on = on && sensor_fault == SENSOR_OK;
+
+    if (relay_deadman_trips != relay_deadman_logged) {
+        relay_deadman_logged = relay_deadman_trips;
+        log_event(LOG_RELAY_DEADMAN, (int16_t)relay_deadman_logged);
+    }
+
+    if (on) {
+        hardware_alarm_set_target(relay_deadman_alarm, make_timeout_time_ms(RELAY_DEADMAN_MS));
+    } else {
+        hardware_alarm_cancel(relay_deadman_alarm);
+    }
+    relay_on = on;
+    gpio_put(PIN_RELAY, on);
+}
+
+/* --- Sensor fault detection --- */
+static uint16_t last_raw_frame = 0;
+static float last_valid_temp = -1;
+static absolute_time_t last_valid_time = 0;
+static absolute_time_t stuck_since = 0;
+
+/**
+ * Checks one MAX6675 frame against the previous sample.
+ * @returns The detected fault, or SENSOR_OK if the frame is plausible
+ */
+static SensorFault check_sensor_frame(uint16_t frame, float temp, absolute_time_t now) {
+    // D15 is a dummy sign bit and D1 the device ID, both always read as 0,
+    // so a floating MISO line (0xFFFF) fails here. 0x0000 is a real 0 C
+    // reading; a MISO shorted low is caught as a rate jump when the oven is
+    // warm, or as a stuck value once the element heats.
+    if (frame & 0x8002) return SENSOR_FAULT_BUS;
+    if (frame & 0x0004) return SENSOR_FAULT_OPEN;
+
+    if (!is_nil_time(last_valid_time)) {
+        float dt_s = (float)absolute_time_diff_us(last_valid_time, now) / 1e6f;
+        if (dt_s > 0 && fabsf(temp - last_valid_temp) / dt_s > TEMP_MAX_RATE_C_PER_S) {
+            return SENSOR_FAULT_RATE;
+        }
+    }
+
+    if (!relay_on || frame != last_raw_frame || is_nil_time(stuck_since)) {
+        stuck_since = now;
+    } else if (absolute_time_diff_us(stuck_since, now) >= (int64_t)TEMP_STUCK_MS * 1000) {
+        return SENSOR_FAULT_STUCK;
+    }
+    return SENSOR_OK;
+}
+
+static void raise_sensor_fault(SensorFault fault, uint16_t frame) {
+    if (sensor_fault != SENSOR_OK) return;
+    sensor_fault = fault;
+    relay_set(false);
+    log_event(LOG_SENSOR_FAULT, (int16_t)fault);
+    (void)frame; // Only shown in debug builds
+    DPRINTF("Sensor fault E%d (frame %04x)\n", fault, frame);
+}
+
+/* Clears a latched fault; the next sample re-raises it if it persists */
+static void clear_sensor_fault(void) {
+    sensor_fault = SENSOR_OK;
+    last_valid_time = nil_time;
+    stuck_since = nil_time;
+}
+
+/* Clocks one 16-bit frame out of the MAX6675 selected by `cs` */
+static uint16_t read_sensor_frame(uint cs) {
+    uint8_t buffer[2];
+    gpio_put(cs, 0);
     spi_read_blocking(SPI_PORT, 0, buffer, 2);
-    gpio_put(PIN_CS, 1);
+    gpio_put(cs, 1);
+    return ((uint16_t)buffer[0] << 8) | (uint16_t)buffer[1];
+}
+
+/* Picks the next sensor read interval from what the reading is used for */
+static int64_t temp_refresh_interval_us(bool running, bool screen_on) {
+    if (!running) return screen_on ? TEMP_REFRESH_IDLE_US : TEMP_REFRESH_SLEEP_US;
+    if (fabsf(current_temp - (float)temp_target) < TEMP_FAST_BAND_C || fabsf(temp_rate) > TEMP_FAST_RATE_C_PER_S) {
+        return MIN_TEMP_REFRESH_US;
+    }
+    return TEMP_REFRESH_RUN_US;
+}
+
+static TimerWheelEntry sensor_timer;
+static int64_t sensor_interval_us = 0; // What sensor_timer was last timed for
+static bool sensor_due = true;
+
+static void sensor_timer_fired(TimerWheelEntry *e, void *arg) {
+    (void)e, (void)arg;
+    sensor_due = true;
+}
+
+/*
+ * Times the next read interval_us after the last one. Never early: a read
+ * before the MAX6675 finishes converting returns the previous frame again.
+ */
+static void sensor_timer_restart(int64_t interval_us) {
+    sensor_interval_us = interval_us;
+    absolute_time_t due = delayed_by_us(temp_sample_time, (uint64_t)interval_us);
+    if (absolute_time_diff_us(get_absolute_time(), due) <= 0) {
+        sensor_due = true;
+        timer_cancel(&sensor_timer);
+    } else {
+        timer_start_at(&sensor_timer, due, sensor_timer_fired, NULL);
+    }
+}
+
+/* Forces the next update_temp call to read the sensor */
+static inline void request_temp_update(void) {
+    sensor_due = true;
+    timer_cancel(&sensor_timer);
+}
+
+/* Prints sensor reads per hour, idle vs running */
+static void report_sensor_rates(void) {
+    for (int i = 0; i < 2; i++) {
+        uint32_t per_hour = sensor_time_us[i] ? (uint32_t)((uint64_t)sensor_reads[i] * 3600000000ull / sensor_time_us[i]) : 0;
+        printf("SENSOR %s %lu reads/h\n", i ? "running" : "idle", (unsigned long)per_hour);
+    }
+}
+
+/**
+ * Updates the current temperature
+ * @returns Whether the temperature was update (Irrespective of whether it was changed)
+ */
+static bool update_temp(bool running, bool screen_on) {
+    // The interval follows what the reading is for; when that changes the
+    // new one counts from the last read
+    int64_t interval_us = temp_refresh_interval_us(running, screen_on);
+    if (!sensor_due && interval_us != sensor_interval_us) sensor_timer_restart(interval_us);
+    if (!sensor_due) return false;
+
+    sensor_due = false;
+    uint16_t frame = read_sensor_frame(PIN_CS);
+    temp_sample_time = get_absolute_time();
+    sensor_timer_restart(interval_us);
+    sensor_reads[running]++;
+    heartbeat(TASK_SENSOR);
+
+    float temp = (float)(frame >> 3) * 0.25f;
+
+    SensorFault fault = check_sensor_frame(frame, temp, temp_sample_time);
+    last_raw_frame = frame;
+    if (fault != SENSOR_OK) {
+        // Cut the relay here rather than waiting for process_cycle so the
+        // response time is bounded by a single sample period.
+        raise_sensor_fault(fault, frame);
+        return true;
+    }
 
-    last_temp_check = get_absolute_time();
+    // Sample intervals vary, so weight the derivative filter by the real dt
+    if (!is_nil_time(last_valid_time)) {
+        float dt_s = (float)absolute_time_diff_us(last_valid_time, temp_sample_time) / 1e6f;
+        float alpha = dt_s / (TEMP_RATE_FILTER_S + dt_s);
+        temp_rate += alpha * ((temp - last_valid_temp) / dt_s - temp_rate);
+    } else {
+        temp_rate = 0;
+    }
 
-    uint16_t raw = ((uint16_t)buffer[0] << 8) | (uint16_t)buffer[1];
-    raw = raw >> 3;
-    current_temp = (float)raw * 0.25f;
+    last_valid_temp = temp;
+    last_valid_time = temp_sample_time;
+    current_temp = temp;
     return true;
 }
 
+#if ELEMENT_SENSOR
+static absolute_time_t last_element_check = 0;
+
+/*
+ * Reads the element thermocouple at the sensor's full rate while a cycle
+ * runs. The element legitimately moves faster than the cavity rate limit,
+ * so only bus and open-probe faults are checked; either one drops control
+ * back to the cavity alone rather than stopping the cycle.
+ */
+static void update_element_temp(bool running) {
+    if (!running) {
+        element_temp = NAN;
+        return;
+    }
+    if (!is_nil_time(last_element_check) && absolute_time_diff_us(last_element_check, get_absolute_time()) < MIN_TEMP_REFRESH_US) {
+        return;
+    }
+    uint16_t frame = read_sensor_frame(PIN_CS_ELEMENT);
+    last_element_check = get_absolute_time();
+
+    bool valid = frame != 0x0000 && !(frame & 0x8006);
+    if (!valid && !isnan(element_temp)) log_event(LOG_ELEMENT_SENSOR, (int16_t)frame);
+    element_temp = valid ? (float)(frame >> 3) * 0.25f : NAN;
+}
+#endif
+
 /* --- Button helper structure and functions --- */
 typedef struct ButtonState {
     uint pin;
     bool prev;
     bool cur;
     bool stale; // used for the up-button long-press logic
-    int press_time_ms;
+    bool held;  // Down longer than hold_timer, LONG_PRESS_MS unless retimed
+    TimerWheelEntry hold_timer;
 } ButtonState;
 
 static inline void button_init(ButtonState *b, uint pin) {
@@ -153,29 +714,204 @@ static inline void button_init(ButtonState *b, uint pin) {
     b->prev = false;
     b->cur = false;
     b->stale = false;
-    b->press_time_ms = 0;
+    b->held = false;
+    b->hold_timer = (TimerWheelEntry){0};
+}
+
+static void button_held(TimerWheelEntry *e, void *arg) {
+    (void)e;
+    ((ButtonState *)arg)->held = true;
 }
 
-static inline void button_update(ButtonState *b, int delta_ms) {
+static inline void button_update(ButtonState *b) {
     b->prev = b->cur;
     b->cur = !gpio_get(b->pin); // active-low buttons
     // maintain stale flag similar to original behaviour
     b->stale = b->stale && b->prev;
-    if (b->cur) {
-        b->press_time_ms += delta_ms;
-    } else {
-        b->press_time_ms = 0;
+    if (b->cur && !b->prev) {
+        timer_start(&b->hold_timer, LONG_PRESS_MS, 0, button_held, b);
+    } else if (!b->cur) {
+        timer_cancel(&b->hold_timer);
+        b->held = false;
+    }
+}
+
+/* Makes holding the current press take hold_ms from now instead */
+static inline void button_retime_hold(ButtonState *b, uint32_t hold_ms) {
+    b->held = false;
+    timer_start(&b->hold_timer, hold_ms, 0, button_held, b);
+}
+
+/* Swallows the current press so no handler sees its edges */
+static inline void button_consume(ButtonState *b) {
+    b->prev = b->cur;
+    b->stale = true;
+}
+
+/* --- I2C bus speed management --- */
+// Candidate rates, slowest first: standard, fast and fast-mode plus
+static const uint32_t i2c_rates[] = {100000, 400000, 1000000};
+static int i2c_rate_index = 0;
+static uint32_t i2c_baud = 0;          // Rate actually achieved by the divider
+static uint32_t i2c_error_run = 0;     // Consecutive failed writes
+static uint32_t i2c_errors = 0;
+static bool lcd_needs_init = false;    // Set when a fallback may have desynced the LCD
+static bool lcd_encoding_stale = true; // Set when the rate or backlight changes what a write encodes to
+static uint32_t lcd_frame_us = 0;
+static uint32_t lcd_frame_max_us = 0;
+static uint32_t lcd_encode_us = 0;     // Building the frame's expander bytes
+static uint32_t lcd_transfer_us = 0;   // Sending them
+static uint32_t lcd_frame_bytes = 0;
+
+static void i2c_select_rate(int index) {
+    i2c_rate_index = index;
+    i2c_baud = i2c_set_baudrate(I2C_PORT, i2c_rates[index]);
+    i2c_error_run = 0;
+    lcd_encoding_stale = true;
+}
+
+/*
+ * Writes a pattern to the PCF8574 with E low (the LCD ignores it) and reads
+ * the port back. The backlight pin is masked off since its transistor can
+ * hold the quasi-bidirectional output low.
+ */
+static bool i2c_probe_expander(void) {
+    static const uint8_t patterns[] = {0xA1, 0x50, 0xF0, 0x01};
+    const uint8_t mask = 0xF1; // D7-D4 and RS
+    for (int round = 0; round < I2C_PROBE_ROUNDS; round++) {
+        uint8_t out = patterns[round % count_of(patterns)];
+        uint8_t in;
+        if (i2c_write_timeout_us(I2C_PORT, lcd_addr, &out, 1, false, I2C_TIMEOUT_US) != 1) return false;
+        if (i2c_read_timeout_us(I2C_PORT, lcd_addr, &in, 1, false, I2C_TIMEOUT_US) != 1) return false;
+        if ((in & mask) != (out & mask)) return false;
+    }
+    return true;
+}
+
+/* Steps the clock up from the slowest rate and keeps the fastest that verifies */
+static void i2c_tune_rate(void) {
+    int best = 0;
+    for (int i = 0; i < (int)count_of(i2c_rates); i++) {
+        i2c_select_rate(i);
+        if (!i2c_probe_expander()) break;
+        best = i;
+    }
+    i2c_select_rate(best);
+}
+
+/* Called on every failed write; steps down a rate after a run of errors */
+static void i2c_note_error(void) {
+    i2c_errors++;
+    if (++i2c_error_run < I2C_FALLBACK_ERRORS || i2c_rate_index == 0) return;
+    i2c_select_rate(i2c_rate_index - 1);
+    lcd_needs_init = true;
+    log_event(LOG_I2C_FALLBACK, (int16_t)(i2c_baud / 1000));
+}
+
+/* --- Board temperature protection --- */
+static float board_temp = NAN;        // Filtered die temperature, Celsius
+static bool board_derated = false;
+static bool board_hot = false;        // Shutdown latched until it cools
+static uint32_t board_temp_last_ms = 0;
+static uint32_t board_window_start_ms = 0;
+static uint32_t board_window_on_ms = 0;
+static uint32_t board_window_last_ms = 0;
+
+/* Starts the first conversion; each sample then starts the next */
+static void init_board_temp(void) {
+    adc_init();
+    adc_set_temp_sensor_enabled(true);
+    adc_select_input(4);
+    hw_set_bits(&adc_hw->cs, ADC_CS_START_ONCE_BITS);
+}
+
+/* Re-derives peripheral dividers after a system clock change */
+static void board_set_clock(uint32_t khz) {
+    set_sys_clock_khz(khz, false);
+    spi_set_baudrate(SPI_PORT, SPI_BAUD);
+    i2c_select_rate(i2c_rate_index);
+#if POWER_BUS
+    uart_set_baudrate(BUS_UART, BUS_BAUD);
+#endif
+}
+
+static void board_set_derated(bool derated) {
+    if (derated == board_derated) return;
+    board_derated = derated;
+    board_set_clock(derated ? BOARD_DERATE_SYS_KHZ : SYS_CLK_KHZ);
+    log_event(LOG_BOARD_TEMP, (int16_t)(derated ? board_temp : -board_temp));
+}
+
+/*
+ * Collects the conversion started on the previous call and starts another.
+ * A conversion takes 2us, so the result is always waiting and this never
+ * blocks.
+ */
+static void board_temp_task(void) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (now - board_temp_last_ms < BOARD_TEMP_PERIOD_MS) return;
+    board_temp_last_ms = now;
+    if (!(adc_hw->cs & ADC_CS_READY_BITS)) return;
+
+    // RP2040 datasheet: 0.706V at 27C, -1.721mV/C
+    float volts = (float)(adc_hw->result & 0xfff) * (3.3f / 4096.0f);
+    hw_set_bits(&adc_hw->cs, ADC_CS_START_ONCE_BITS);
+    float temp = 27.0f - (volts - 0.706f) / 0.001721f;
+    board_temp = isnan(board_temp) ? temp : board_temp + (temp - board_temp) / 8.0f;
+
+    if (board_temp >= BOARD_TEMP_WARN_C) {
+        board_set_derated(true);
+    } else if (board_temp < BOARD_TEMP_WARN_C - BOARD_TEMP_HYSTERESIS_C) {
+        board_set_derated(false);
+    }
+
+    if (board_temp >= BOARD_TEMP_SHUTDOWN_C) {
+        if (!board_hot) log_event(LOG_BOARD_TEMP, (int16_t)board_temp);
+        board_hot = true;
+    } else if (board_temp < BOARD_TEMP_SHUTDOWN_C - BOARD_TEMP_HYSTERESIS_C) {
+        board_hot = false;
     }
+    // Re-raised after every acknowledgement until the board has cooled
+    if (board_hot) raise_sensor_fault(SENSOR_FAULT_BOARD_HOT, 0);
+}
+
+/**
+ * Caps the element's duty over a sliding window while derated, since the
+ * element is what heats the board.
+ * @returns Whether the relay may be on this pass
+ */
+static bool board_power_allows(bool demand) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (relay_on) board_window_on_ms += now - board_window_last_ms;
+    board_window_last_ms = now;
+    if (now - board_window_start_ms >= BOARD_DERATE_WINDOW_MS) {
+        board_window_start_ms = now;
+        board_window_on_ms = 0;
+    }
+    if (!board_derated) return demand;
+    return demand && board_window_on_ms < BOARD_DERATE_WINDOW_MS * BOARD_DERATE_DUTY_PCT / 100;
 }
 
 /* --- Minimal I2C helper (single byte) --- */
 void i2c_write_byte(uint8_t val) {
-#ifdef i2c_default
-    i2c_write_blocking(i2c_default, lcd_addr, &val, 1, false);
-#endif
+    if (i2c_write_timeout_us(I2C_PORT, lcd_addr, &val, 1, false, I2C_TIMEOUT_US) != 1) {
+        i2c_note_error();
+    } else {
+        i2c_error_run = 0;
+    }
 }
 
 /* --- LCD helpers --- */
+// Commands (init, clear, display on/off) go out a byte at a time with
+// generous delays. Frames are buffered instead: every write is encoded as
+// expander bytes from a table and the whole frame is sent in one transfer.
+#define LCD_WIDTH           16
+#define LCD_EXEC_US         40   // HD44780 execution time for a write or cursor move
+#define LCD_CLEAR_US        1600 // And for a clear
+#define LCD_WRITE_BYTES_MAX 10   // Expander bytes per write, with padding
+#define LCD_BUFFER_BYTES    512
+#define LCD_STATIC_SLOTS    16
+
 static void lcd_toggle_enable(uint8_t val) {
     const uint32_t DELAY_US = 600;
     sleep_us(DELAY_US);
@@ -185,27 +921,120 @@ static void lcd_toggle_enable(uint8_t val) {
     sleep_us(DELAY_US);
 }
 
+static uint8_t lcd_write_len = 6;                            // Expander bytes per write at this rate
+static uint8_t lcd_char_bytes[256][LCD_WRITE_BYTES_MAX];     // Encoded character writes
+static uint8_t lcd_buffer[LCD_BUFFER_BYTES];
+static size_t lcd_buffer_len = 0;
+
+// Constant strings, encoded the first time they are drawn
+typedef struct LcdStatic {
+    const char *text;
+    uint16_t len;
+    uint8_t bytes[LCD_WIDTH * LCD_WRITE_BYTES_MAX];
+} LcdStatic;
+
+static LcdStatic lcd_statics[LCD_STATIC_SLOTS];
+static int lcd_static_count = 0;
+
+/*
+ * Encodes one write: each nibble is set up, strobed and held, so E only
+ * ever changes with the data stable. The last byte is repeated as padding
+ * until the write takes LCD_EXEC_US on the bus.
+ */
+static void lcd_encode(uint8_t *out, uint8_t val, int mode) {
+    uint8_t high = mode | (val & 0xF0) | (LCD_BACKLIGHT * backlightEnabled);
+    uint8_t low = mode | ((val << 4) & 0xF0) | (LCD_BACKLIGHT * backlightEnabled);
+    int n = 0;
+    out[n++] = high;
+    out[n++] = high | LCD_ENABLE_BIT;
+    out[n++] = high;
+    out[n++] = low;
+    out[n++] = low | LCD_ENABLE_BIT;
+    while (n < lcd_write_len) out[n++] = low;
+}
+
+/* Rebuilds the character table for the current rate and backlight */
+static void lcd_encode_tables(void) {
+    // The controller is busy from the low nibble's falling E until
+    // LCD_EXEC_US later, and the next write latches three bytes after the
+    // padding. A byte is nine clocks.
+    uint32_t busy_bytes = (uint32_t)(((uint64_t)LCD_EXEC_US * i2c_baud + 8999999) / 9000000);
+    lcd_write_len = (uint8_t)MIN(MAX(3 + busy_bytes, 6u), LCD_WRITE_BYTES_MAX);
+    for (int c = 0; c < 256; c++) lcd_encode(lcd_char_bytes[c], (uint8_t)c, LCD_CHARACTER);
+    lcd_static_count = 0;
+    lcd_encoding_stale = false;
+}
+
+/* Sends the buffered writes as one transfer */
+static void lcd_flush(void) {
+    if (lcd_buffer_len == 0) return;
+    int sent = i2c_write_timeout_per_char_us(I2C_PORT, lcd_addr, lcd_buffer, lcd_buffer_len, false, I2C_TIMEOUT_US);
+    if (sent != (int)lcd_buffer_len) {
+        i2c_note_error();
+        // A partial transfer can stop between the nibbles of a write
+        lcd_needs_init = true;
+    } else {
+        i2c_error_run = 0;
+    }
+    lcd_buffer_len = 0;
+}
+
+/* Makes room for len bytes, sending what is buffered if it won't fit */
+static uint8_t *lcd_reserve(size_t len) {
+    if (lcd_buffer_len + len > LCD_BUFFER_BYTES) lcd_flush();
+    uint8_t *out = &lcd_buffer[lcd_buffer_len];
+    lcd_buffer_len += len;
+    return out;
+}
+
 static void lcd_send_byte(uint8_t val, int mode) {
     uint8_t high = mode | (val & 0xF0) | (LCD_BACKLIGHT * backlightEnabled);
     uint8_t low = mode | ((val << 4) & 0xF0) | (LCD_BACKLIGHT * backlightEnabled);
 
+    lcd_flush();
     i2c_write_byte(high);
     lcd_toggle_enable(high);
     i2c_write_byte(low);
     lcd_toggle_enable(low);
 }
 
-static void lcd_clear(void) { lcd_send_byte(LCD_CLEARDISPLAY, LCD_COMMAND); }
+static void lcd_clear(void) {
+    lcd_send_byte(LCD_CLEARDISPLAY, LCD_COMMAND);
+    // A buffered frame would reach the controller before the clear finished
+    sleep_us(LCD_CLEAR_US);
+}
 
 static void lcd_set_cursor(int line, int position) {
     int val = (line == 0) ? 0x80 + position : 0xC0 + position;
-    lcd_send_byte(val, LCD_COMMAND);
+    if (lcd_encoding_stale) lcd_encode_tables();
+    lcd_encode(lcd_reserve(lcd_write_len), (uint8_t)val, LCD_COMMAND);
 }
 
-static inline void lcd_char(char val) { lcd_send_byte((uint8_t)val, LCD_CHARACTER); }
-
 static void lcd_string(const char *s) {
-    while (*s) lcd_char(*s++);
+    if (lcd_encoding_stale) lcd_encode_tables();
+    for (; *s; s++) memcpy(lcd_reserve(lcd_write_len), lcd_char_bytes[(uint8_t)*s], lcd_write_len);
+}
+
+/* Draws a string that never changes, from its cached encoding */
+static void lcd_static(const char *s) {
+    if (lcd_encoding_stale) lcd_encode_tables();
+    LcdStatic *cached = NULL;
+    for (int i = 0; i < lcd_static_count && !cached; i++) {
+        if (lcd_statics[i].text == s) cached = &lcd_statics[i];
+    }
+    if (!cached) {
+        if (lcd_static_count == LCD_STATIC_SLOTS || strlen(s) > LCD_WIDTH) {
+            lcd_string(s);
+            return;
+        }
+        cached = &lcd_statics[lcd_static_count++];
+        cached->text = s;
+        cached->len = 0;
+        for (; *s; s++, cached->len += lcd_write_len) {
+            memcpy(&cached->bytes[cached->len], lcd_char_bytes[(uint8_t)*s], lcd_write_len);
+        }
+    }
+    memcpy(lcd_reserve(cached->len), cached->bytes, cached->len);
 }
 
 static void lcd_init(void) {
@@ -222,25 +1051,686 @@ static void lcd_init(void) {
 
 static void lcd_off(void) {
     backlightEnabled = false;
+    lcd_encoding_stale = true;
     lcd_send_byte(LCD_DISPLAYCONTROL, LCD_COMMAND);
 }
 
 static void lcd_on(void) {
     backlightEnabled = true;
+    lcd_encoding_stale = true;
     lcd_send_byte(LCD_DISPLAYCONTROL | LCD_DISPLAYON, LCD_COMMAND);
 }
 
+/* --- Flash layout --- */
+// Persistent records live in the last sectors of flash, below the end of
+// the image's reach. Each user owns whole sectors.
+#define FLASH_CHECKPOINT_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define FLASH_BENCH_OFFSET      (PICO_FLASH_SIZE_BYTES - 2 * FLASH_SECTOR_SIZE)
+#define FLASH_CYCLE_LOG_OFFSET  (PICO_FLASH_SIZE_BYTES - (2 + CYCLE_LOG_SECTORS) * FLASH_SECTOR_SIZE)
+#define FLASH_PRESET_OFFSET     (PICO_FLASH_SIZE_BYTES - (3 + CYCLE_LOG_SECTORS) * FLASH_SECTOR_SIZE)
+
+/* FNV-1a, used to validate records read back from flash */
+static uint32_t checksum32(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint32_t h = 2166136261u;
+    while (len--) h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+/*
+ * Programs one record into an erased page. Bytes outside the record stay
+ * 0xFF, which leaves anything already programmed in that page untouched.
+ */
+static void flash_write_record(uint32_t offset, const void *record, size_t len) {
+    uint8_t page[FLASH_PAGE_SIZE];
+    uint32_t page_offset = offset & ~(FLASH_PAGE_SIZE - 1);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page + (offset - page_offset), record, len);
+
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_program(page_offset, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+}
+
+static void flash_erase_sector(uint32_t offset) {
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(ints);
+}
+
+/* --- Cycle checkpoints --- */
+#define CHECKPOINT_MAGIC 0x43594331u // "CYC1"
+
+typedef struct Checkpoint {
+    uint32_t magic;
+    uint16_t seq;
+    uint8_t mode;
+    uint8_t stage;
+    int16_t temp_target;  // Celsius
+    int16_t temp_x4;      // Cavity temperature when written, quarter degrees
+    int32_t time_target;  // Remaining milliseconds
+    int16_t toast_time;
+    int16_t bake_time;
+    int16_t bake_temp;
+    uint8_t reserved[6];
+    uint32_t check;
+} Checkpoint;
+
+_Static_assert(sizeof(Checkpoint) == 32, "Checkpoint must tile flash pages");
+
+// Records with no time left are markers, and their mode says why
+#define CHECKPOINT_MARK_BOOT  0xFE // A boot has offered the cycle before it
+#define CHECKPOINT_MARK_CLEAR 0xFF // The cycle finished or was not resumed
+
+// One cycle's records: the countdown's periodic checkpoints, the start and
+// two stage changes, and a boot and a clear marker. Preheat only writes on
+// stage changes, so its length doesn't count.
+#define CHECKPOINT_SLOTS       (FLASH_SECTOR_SIZE / sizeof(Checkpoint))
+#define CHECKPOINT_CYCLE_SLOTS (((TOAST_TIME_MAX > BAKE_TIME_MAX) ? TOAST_TIME_MAX : BAKE_TIME_MAX) * 1000 / CHECKPOINT_PERIOD_MS + 1 + 3 + 2)
+_Static_assert(CHECKPOINT_CYCLE_SLOTS <= CHECKPOINT_SLOTS,
+               "A full cycle must fit one checkpoint sector without erasing mid-cycle");
+
+static const Checkpoint* const checkpoint_slots = (const Checkpoint *)(XIP_BASE + FLASH_CHECKPOINT_OFFSET);
+static uint32_t checkpoint_next = 0; // First free slot
+static uint16_t checkpoint_seq = 0;
+static absolute_time_t last_checkpoint;
+static uint8_t checkpoint_stage = 0;
+static bool checkpoint_live = false; // The newest record is a checkpoint, not a marker
+
+static Checkpoint resume_point;
+static bool resume_pending = false;
+static TimerWheelEntry resume_timer; // Pending until the prompt times out
+
+static bool checkpoint_valid(const Checkpoint *c) {
+    return c->magic == CHECKPOINT_MAGIC && c->check == checksum32(c, offsetof(Checkpoint, check));
+}
+
+/* The cavity target a cycle of this mode runs at, in Celsius */
+static int mode_temp_target(uint8_t mode) {
+    return (mode == 1) ? (int)((float)(bake_temp - 32) * (5.0f / 9.0f)) : TOAST_TEMP_C;
+}
+
+/**
+ * Seals and appends a record. One page program, no erase.
+ * @returns false if the sector is full
+ */
+static bool checkpoint_append(Checkpoint *c) {
+    if (checkpoint_next >= CHECKPOINT_SLOTS) return false;
+    c->magic = CHECKPOINT_MAGIC;
+    c->seq = ++checkpoint_seq;
+    memset(c->reserved, 0xFF, sizeof(c->reserved));
+    c->check = checksum32(c, offsetof(Checkpoint, check));
+
+    flash_write_record(FLASH_CHECKPOINT_OFFSET + checkpoint_next * sizeof(Checkpoint), c, sizeof(*c));
+    checkpoint_next++;
+    return true;
+}
+
+/*
+ * Zeroes the newest record's magic, which a page program can do without an
+ * erase. Boot treats a zeroed record as the end of everything before it.
+ */
+static void checkpoint_invalidate(void) {
+    checkpoint_live = false;
+    if (checkpoint_next == 0) return;
+    const uint32_t dead = 0;
+    flash_write_record(FLASH_CHECKPOINT_OFFSET + (checkpoint_next - 1) * sizeof(Checkpoint), &dead, sizeof(dead));
+}
+
+/**
+ * Ends the checkpointed cycle with a marker, so no boot offers it. With the
+ * sector full the newest checkpoint is invalidated instead.
+ * @returns false if no marker could be written
+ */
+static bool checkpoint_mark(uint8_t why) {
+    checkpoint_live = false;
+    if (checkpoint_append(&(Checkpoint){.mode = why})) return true;
+    checkpoint_invalidate();
+    return false;
+}
+
+/* Appends the running cycle's state */
+static void checkpoint_write(uint8_t mode) {
+    Checkpoint c = {
+        .mode = mode,
+        .stage = heating_stage,
+        .temp_target = (int16_t)temp_target,
+        .temp_x4 = (int16_t)(current_temp * 4),
+        .time_target = time_target,
+        .toast_time = (int16_t)toast_time,
+        .bake_time = (int16_t)bake_time,
+        .bake_temp = (int16_t)bake_temp,
+    };
+    if (!checkpoint_append(&c)) {
+        // The budget should make this unreachable. Better no resume than a
+        // stale one, and no retry until the next cycle makes room.
+        if (checkpoint_live) {
+            log_event(LOG_CHECKPOINT_FULL, (int16_t)checkpoint_next);
+            DPRINTF("Checkpoint sector full, resume disabled for this cycle\n");
+            checkpoint_invalidate();
+        }
+        last_checkpoint = get_absolute_time();
+        checkpoint_stage = heating_stage;
+        return;
+    }
+    checkpoint_live = true;
+    last_checkpoint = get_absolute_time();
+    checkpoint_stage = heating_stage;
+}
+
+/*
+ * Checkpointing from the main loop. Only the start, stage changes and the
+ * stage-2 countdown are written, so the records a cycle needs are bounded
+ * by CHECKPOINT_CYCLE_SLOTS however long preheat takes.
+ */
+static void checkpoint_task(bool running, uint8_t mode) {
+    if (!running) return;
+    bool first = is_nil_time(last_checkpoint);
+    int64_t since_ms = first ? INT64_MAX : absolute_time_diff_us(last_checkpoint, get_absolute_time()) / 1000;
+    bool changed = first || heating_stage != checkpoint_stage;
+    if (changed ? since_ms >= CHECKPOINT_MIN_MS : (heating_stage == 2 && since_ms >= CHECKPOINT_PERIOD_MS)) {
+        checkpoint_write(mode);
+    }
+}
+
+/* Forgets the checkpointed cycle. A page program, so fine at the end of a cycle. */
+static void checkpoint_clear(void) {
+    if (checkpoint_live && !checkpoint_mark(CHECKPOINT_MARK_CLEAR)) {
+        log_event(LOG_CHECKPOINT_FULL, (int16_t)checkpoint_next);
+    }
+    last_checkpoint = nil_time;
+}
+
+/*
+ * Makes room for a whole cycle's checkpoints. This is the only erase, and
+ * it runs as a cycle starts, before the relay first closes, so the
+ * tens of milliseconds with interrupts off never land mid-cycle.
+ */
+static void checkpoint_prepare(void) {
+    if (checkpoint_next + CHECKPOINT_CYCLE_SLOTS <= CHECKPOINT_SLOTS) return;
+    flash_erase_sector(FLASH_CHECKPOINT_OFFSET);
+    checkpoint_next = 0;
+    checkpoint_live = false;
+}
+
+/**
+ * Looks for a cycle interrupted by a reset and decides whether to offer it.
+ * Only the newest record counts, so a cycle is offered on the first boot
+ * after its last checkpoint and never again. Needs a fresh temperature
+ * reading.
+ */
+static void checkpoint_boot(void) {
+    const Checkpoint *latest = NULL;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < CHECKPOINT_SLOTS; i++) {
+        if (checkpoint_slots[i].magic == 0xFFFFFFFFu) break;
+        used = i + 1;
+        if (checkpoint_slots[i].magic == 0) latest = NULL; // Invalidated
+        else if (checkpoint_valid(&checkpoint_slots[i])) latest = &checkpoint_slots[i];
+    }
+    checkpoint_next = used;
+    checkpoint_live = latest && latest->time_target > 0;
+    if (!checkpoint_live) return;
+
+    Checkpoint c = *latest;
+    if (c.mode > 2 || c.stage > 2 || sensor_fault != SENSOR_OK || current_temp < RESUME_MIN_TEMP_C ||
+        current_temp < c.temp_x4 / 4.0f - RESUME_MAX_DROP_C) {
+        checkpoint_clear();
+        return;
+    }
+
+    // Settings come back within this profile's limits, and the target and
+    // time left follow from them as they would on a fresh start
+    c.toast_time = (int16_t)MIN(MAX(c.toast_time, TOAST_TIME_MIN), TOAST_TIME_MAX);
+    c.bake_time = (int16_t)MIN(MAX(c.bake_time, BAKE_TIME_MIN), BAKE_TIME_MAX);
+    c.bake_temp = (int16_t)MIN(MAX(c.bake_temp, BAKE_TEMP_MIN), BAKE_TEMP_MAX);
+    c.time_target = MIN(c.time_target, (int32_t)((c.mode == 0) ? c.toast_time : c.bake_time) * 1000);
+
+    // Record this boot before offering, so an outage during the prompt
+    // (or a boot loop) can't bring the cycle back later. If the sector is
+    // full the checkpoint was invalidated instead, and isn't offered.
+    if (!checkpoint_mark(CHECKPOINT_MARK_BOOT)) return;
+    resume_point = c;
+    resume_pending = true;
+    timer_start(&resume_timer, RESUME_PROMPT_MS, 0, NULL, NULL);
+    DPRINTF("Offering resume of mode %d, %ld ms left\n", c.mode, (long)c.time_target);
+}
+
+/* --- Presets --- */
+#define PRESET_MAGIC 0x50525331u // "PRS1"
+
+// Appended on every save; the newest record for a slot wins
+typedef struct Preset {
+    uint32_t magic;
+    uint8_t slot;
+    uint8_t mode;
+    int16_t toast_time;
+    int16_t bake_time;
+    int16_t bake_temp;
+    uint32_t check;
+} Preset;
+
+_Static_assert(sizeof(Preset) == 16, "Preset must tile flash pages");
+
+#define PRESET_RECORDS (FLASH_SECTOR_SIZE / sizeof(Preset))
+
+static const Preset* const preset_records = (const Preset *)(XIP_BASE + FLASH_PRESET_OFFSET);
+static Preset presets[PRESET_SLOTS]; // magic is 0 for an empty slot
+static uint32_t preset_next = 0;     // First free record
+
+static bool preset_valid(const Preset *p) {
+    return p->magic == PRESET_MAGIC && p->slot < PRESET_SLOTS &&
+           p->check == checksum32(p, offsetof(Preset, check));
+}
+
+static void preset_boot(void) {
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < PRESET_RECORDS; i++) {
+        if (preset_records[i].magic == 0xFFFFFFFFu) break;
+        used = i + 1;
+        if (preset_valid(&preset_records[i])) presets[preset_records[i].slot] = preset_records[i];
+    }
+    preset_next = used;
+}
+
+/* Stores the current settings in a slot. Compacts the sector when it fills. */
+static void preset_save(uint8_t slot, uint8_t mode) {
+    Preset p = {
+        .magic = PRESET_MAGIC,
+        .slot = slot,
+        .mode = mode,
+        .toast_time = (int16_t)toast_time,
+        .bake_time = (int16_t)bake_time,
+        .bake_temp = (int16_t)bake_temp,
+    };
+    p.check = checksum32(&p, offsetof(Preset, check));
+    presets[slot] = p;
+
+    if (preset_next >= PRESET_RECORDS) {
+        flash_erase_sector(FLASH_PRESET_OFFSET);
+        preset_next = 0;
+        for (uint8_t i = 0; i < PRESET_SLOTS; i++) {
+            if (i == slot || presets[i].magic != PRESET_MAGIC) continue;
+            flash_write_record(FLASH_PRESET_OFFSET + preset_next++ * sizeof(Preset), &presets[i], sizeof(Preset));
+        }
+    }
+    flash_write_record(FLASH_PRESET_OFFSET + preset_next++ * sizeof(Preset), &p, sizeof(p));
+}
+
+/**
+ * Loads a slot into the current settings, clamped to this profile's limits.
+ * @returns false if the slot is empty
+ */
+static bool preset_recall(uint8_t slot, uint8_t *mode) {
+    const Preset *p = &presets[slot];
+    if (p->magic != PRESET_MAGIC) return false;
+    *mode = p->mode < sizeof(modes) / sizeof(modes[0]) ? p->mode : 0;
+    toast_time = MIN(MAX(p->toast_time, TOAST_TIME_MIN), TOAST_TIME_MAX);
+    bake_time = MIN(MAX(p->bake_time, BAKE_TIME_MIN), BAKE_TIME_MAX);
+    bake_temp = MIN(MAX(p->bake_temp, BAKE_TEMP_MIN), BAKE_TEMP_MAX);
+    return true;
+}
+
+static void print_presets(void) {
+    for (uint8_t i = 0; i < PRESET_SLOTS; i++) {
+        const Preset *p = &presets[i];
+        if (p->magic != PRESET_MAGIC) {
+            printf("PRESET %u empty\n", i + 1);
+        } else {
+            printf("PRESET %u mode %u toast %ds bake %ds %dF\n", i + 1, p->mode, p->toast_time, p->bake_time,
+                   p->bake_temp);
+        }
+    }
+}
+
+/* --- Boot self-benchmark --- */
+#define BENCH_MAGIC 0x424e4332u // "BNC2"
+
+typedef struct BenchResults {
+    uint32_t magic;
+    uint32_t i2c_baud;
+    uint32_t lcd_frame_us;
+    uint32_t i2c_byte_us;    // One single-byte expander write
+    uint32_t spi_read_us;    // One MAX6675 frame
+    uint32_t flash_erase_us; // One sector
+    uint32_t flash_program_us; // One page
+    uint32_t loop_us;        // One idle main loop pass, excluding its sleep
+    uint32_t loop_max_us;
+    uint32_t check;
+} BenchResults;
+
+static BenchResults bench;
+static bool diag_screen = false;
+static uint32_t bench_loop_passes = 0; // Still to time before the results are stored
+
+static const BenchResults* const bench_stored = (const BenchResults *)(XIP_BASE + FLASH_BENCH_OFFSET + FLASH_PAGE_SIZE);
+
+static void print_bench(void) {
+    if (bench_loop_passes > 0) {
+        printf("BENCH running\n");
+    } else if (bench.magic != BENCH_MAGIC) {
+        printf("BENCH none\n");
+    } else {
+        printf("BENCH i2c %lu Hz, lcd frame %lu us, i2c byte %lu us, spi read %lu us, flash erase %lu us, program %lu us\n",
+               (unsigned long)bench.i2c_baud, (unsigned long)bench.lcd_frame_us, (unsigned long)bench.i2c_byte_us,
+               (unsigned long)bench.spi_read_us, (unsigned long)bench.flash_erase_us, (unsigned long)bench.flash_program_us);
+        printf("BENCH loop %lu us max %lu us\n", (unsigned long)bench.loop_us, (unsigned long)bench.loop_max_us);
+    }
+}
+
+/* Loads the results of the last benchmark run, if any */
+static void bench_load(void) {
+    if (bench_stored->magic == BENCH_MAGIC && bench_stored->check == checksum32(bench_stored, offsetof(BenchResults, check))) {
+        bench = *bench_stored;
+    }
+}
+
+/*
+ * Times each peripheral on this board. Must run before the watchdog is
+ * enabled: the flash erase alone can take a few hundred milliseconds.
+ * The loop overhead is timed once the main loop runs; see bench_loop_pass.
+ */
+static void run_self_benchmark(void) {
+    absolute_time_t t;
+
+    bench.i2c_baud = i2c_baud;
+
+    t = get_absolute_time();
+    for (int i = 0; i < BENCH_LCD_FRAMES; i++) {
+        lcd_set_cursor(0, 0);
+        lcd_string("  Self-test...  ");
+        lcd_set_cursor(1, 0);
+        lcd_string("                ");
+        lcd_flush();
+    }
+    bench.lcd_frame_us = (uint32_t)(absolute_time_diff_us(t, get_absolute_time()) / BENCH_LCD_FRAMES);
+
+    uint8_t idle = LCD_BACKLIGHT * backlightEnabled;
+    t = get_absolute_time();
+    for (int i = 0; i < BENCH_I2C_WRITES; i++) i2c_write_byte(idle);
+    bench.i2c_byte_us = (uint32_t)(absolute_time_diff_us(t, get_absolute_time()) / BENCH_I2C_WRITES);
+
+    t = get_absolute_time();
+    for (int i = 0; i < BENCH_SPI_READS; i++) read_sensor_frame(PIN_CS);
+    bench.spi_read_us = (uint32_t)(absolute_time_diff_us(t, get_absolute_time()) / BENCH_SPI_READS);
+
+    // Page 0 of the bench sector is a scratch page, page 1 keeps the results
+    uint8_t pattern[FLASH_PAGE_SIZE];
+    for (uint32_t i = 0; i < FLASH_PAGE_SIZE; i++) pattern[i] = (uint8_t)i;
+    t = get_absolute_time();
+    flash_erase_sector(FLASH_BENCH_OFFSET);
+    bench.flash_erase_us = (uint32_t)absolute_time_diff_us(t, get_absolute_time());
+    t = get_absolute_time();
+    flash_write_record(FLASH_BENCH_OFFSET, pattern, sizeof(pattern));
+    bench.flash_program_us = (uint32_t)absolute_time_diff_us(t, get_absolute_time());
+
+    bench.magic = 0;
+    bench.loop_us = 0;
+    bench.loop_max_us = 0;
+    bench_loop_passes = BENCH_LOOP_PASSES;
+
+    // The reads above restarted the MAX6675 conversion
+    sleep_us(MIN_TEMP_REFRESH_US);
+    diag_screen = true;
+}
+
+/* Times the main loop's first passes after a benchmark, then stores and reports the results */
+static void bench_loop_pass(uint32_t work_us) {
+    if (bench_loop_passes == 0) return;
+    bench.loop_us += work_us;
+    bench.loop_max_us = MAX(bench.loop_max_us, work_us);
+    if (--bench_loop_passes > 0) return;
+
+    bench.loop_us /= BENCH_LOOP_PASSES;
+    bench.magic = BENCH_MAGIC;
+    bench.check = checksum32(&bench, offsetof(BenchResults, check));
+    flash_write_record(FLASH_BENCH_OFFSET + FLASH_PAGE_SIZE, &bench, sizeof(bench));
+    print_bench();
+}
+
+static void draw_diag_screen(void) {
+    char line0[17], line1[17];
+    snprintf(line0, 17, "LCD%4lums %4luk ", (unsigned long)MIN(bench.lcd_frame_us / 1000, 9999u), (unsigned long)MIN(bench.i2c_baud / 1000, 9999u));
+    snprintf(line1, 17, "SPI%3luu FL%3lums", (unsigned long)MIN(bench.spi_read_us, 999u), (unsigned long)MIN(bench.flash_erase_us / 1000, 999u));
+    lcd_set_cursor(0, 0);
+    lcd_string(line0);
+    lcd_set_cursor(1, 0);
+    lcd_string(line1);
+}
+
+/* --- Cycle statistics and log --- */
+// Finished cycles are appended to a ring of flash sectors. Every sector but
+// the newest is full, so record k (oldest first) is found by arithmetic.
+#define CYCLE_LOG_PER_SECTOR (FLASH_SECTOR_SIZE / sizeof(CycleLogRecord))
+#define CYCLE_LOG_CAPACITY   (CYCLE_LOG_SECTORS * CYCLE_LOG_PER_SECTOR)
+
+static CycleStats cycle_stats;
+static CycleLogRecord last_cycle;
+static uint8_t cycle_log_used[CYCLE_LOG_SECTORS]; // Programmed slots per sector
+static uint8_t cycle_log_oldest = 0;
+static uint8_t cycle_log_newest = CYCLE_LOG_SECTORS - 1;
+static uint32_t cycle_log_seq = 0;
+
+static bool stats_screen = false;
+static uint8_t stats_page = 0;
+static TimerWheelEntry stats_page_timer;
+static bool stats_page_turned = false; // The page changed and wants drawing
+
+static void stats_page_fired(TimerWheelEntry *e, void *arg) {
+    (void)arg;
+    if (!stats_screen) {
+        timer_cancel(e);
+        return;
+    }
+    stats_page = (stats_page + 1) % (last_cycle.eco_saved_dwh != CYCLE_LOG_NO_ECO ? 5 : 4);
+    stats_page_turned = true;
+}
+
+static const CycleLogRecord *cycle_log_slot(uint32_t sector, uint32_t slot) {
+    return (const CycleLogRecord *)(XIP_BASE + FLASH_CYCLE_LOG_OFFSET + sector * FLASH_SECTOR_SIZE) + slot;
+}
+
+static uint32_t cycle_log_count(void) {
+    uint32_t count = 0;
+    for (int i = 0; i < CYCLE_LOG_SECTORS; i++) count += cycle_log_used[i];
+    return count;
+}
+
+/* @returns Record `index`, oldest first. May fail cycle_log_record_valid if torn. */
+static const CycleLogRecord *cycle_log_get(uint32_t index) {
+    return cycle_log_slot((cycle_log_oldest + index / CYCLE_LOG_PER_SECTOR) % CYCLE_LOG_SECTORS, index % CYCLE_LOG_PER_SECTOR);
+}
+
+/* Rebuilds the ring position from flash at boot */
+static void cycle_log_boot(void) {
+    uint32_t oldest_seq = UINT32_MAX, newest_seq = 0;
+    bool any = false;
+    for (int s = 0; s < CYCLE_LOG_SECTORS; s++) {
+        uint32_t used = 0;
+        while (used < CYCLE_LOG_PER_SECTOR && cycle_log_slot(s, used)->magic != 0xFFFFFFFFu) used++;
+        cycle_log_used[s] = (uint8_t)used;
+        if (!used) continue;
+
+        // Sectors are ordered by the sequence number of their first record
+        uint32_t seq = cycle_log_slot(s, 0)->seq;
+        if (seq < oldest_seq) { oldest_seq = seq; cycle_log_oldest = (uint8_t)s; }
+        if (!any || seq >= newest_seq) { newest_seq = seq; cycle_log_newest = (uint8_t)s; }
+        any = true;
+
+        for (uint32_t i = 0; i < used; i++) {
+            const CycleLogRecord *r = cycle_log_slot(s, i);
+            if (cycle_log_record_valid(r) && r->seq >= cycle_log_seq) cycle_log_seq = r->seq + 1;
+        }
+    }
+    if (!any) {
+        cycle_log_oldest = 0;
+        cycle_log_newest = CYCLE_LOG_SECTORS - 1;
+    }
+}
+
+/* Appends one record. Only called with the relay off: may erase a sector. */
+static void cycle_log_append(CycleLogRecord *r) {
+    if (cycle_log_used[cycle_log_newest] >= CYCLE_LOG_PER_SECTOR || cycle_log_count() == 0) {
+        uint8_t next = (uint8_t)((cycle_log_newest + 1) % CYCLE_LOG_SECTORS);
+        if (cycle_log_used[next]) {
+            // Ring is full: drop the oldest sector
+            flash_erase_sector(FLASH_CYCLE_LOG_OFFSET + next * FLASH_SECTOR_SIZE);
+            cycle_log_used[next] = 0;
+            cycle_log_oldest = (uint8_t)((next + 1) % CYCLE_LOG_SECTORS);
+        }
+        if (cycle_log_count() == 0) cycle_log_oldest = next;
+        cycle_log_newest = next;
+    }
+
+    r->magic = CYCLE_LOG_MAGIC;
+    r->seq = cycle_log_seq++;
+    r->reserved = 0xFF;
+    r->check = cycle_log_checksum(r, offsetof(CycleLogRecord, check));
+
+    uint32_t slot = cycle_log_used[cycle_log_newest]++;
+    flash_write_record(FLASH_CYCLE_LOG_OFFSET + cycle_log_newest * FLASH_SECTOR_SIZE + slot * sizeof(CycleLogRecord), r, sizeof(*r));
+}
+
+static void print_cycle_record(const CycleLogRecord *r) {
+    char line[160];
+    cycle_log_format_csv(r, line, sizeof(line));
+    printf("CYCLE %s\n", line);
+}
+
+static void print_cycle_log(void) {
+    printf("CYCLE %s\n", CYCLE_LOG_CSV_HEADER);
+    uint32_t count = cycle_log_count();
+    for (uint32_t i = 0; i < count; i++) {
+        const CycleLogRecord *r = cycle_log_get(i);
+        if (cycle_log_record_valid(r)) print_cycle_record(r);
+    }
+}
+
+#if USB_MSC_EXPORT
+/* --- USB drive export --- */
+uint32_t export_cycle_count(void) {
+    return cycle_log_count();
+}
+
+const CycleLogRecord *export_cycle_record(uint32_t index) {
+    return cycle_log_get(index);
+}
+
+void export_trace_header(CycleLogHeader *header) {
+    memset(header, 0, sizeof(*header));
+    header->magic = CYCLE_LOG_MAGIC;
+    header->version = CYCLE_LOG_VERSION;
+    header->record_size = sizeof(CycleLogRecord);
+
+    pico_unique_board_id_t id;
+    pico_get_unique_board_id(&id);
+    memcpy(header->unit_id, id.id, sizeof(header->unit_id));
+    header->count = cycle_log_count();
+}
+
+size_t export_settings_text(char *buf, size_t len) {
+    int n = snprintf(buf, len,
+        "oven=%s\r\n"
+        "max_temp_c=%d\r\n"
+        "toast_temp_c=%d\r\n"
+        "toast_time_s=%d\r\n"
+        "bake_time_s=%d\r\n"
+        "bake_temp_f=%d\r\n"
+        "hysteresis_c=%.1f\r\n"
+        "cycles_logged=%lu\r\n",
+        OVEN_NAME, MAX_TEMP_C, TOAST_TEMP_C, toast_time, bake_time, bake_temp,
+        (double)TEMP_HYSTERESIS, (unsigned long)cycle_log_count());
+    if (n < 0) return 0;
+    return (size_t)n < len ? (size_t)n : len - 1;
+}
+#endif
+
+/* Closes the running cycle's statistics, logs them and arms the stats screen */
+static void finish_cycle(uint8_t mode, uint8_t result) {
+    CycleLogRecord *r = &last_cycle;
+    r->end_ms = to_ms_since_boot(get_absolute_time());
+    int64_t wall_ms = wall_time_ms(r->end_ms);
+    r->wall_time = wall_ms < 0 ? CYCLE_LOG_NO_WALL_TIME : (uint32_t)(wall_ms / 1000);
+    r->mode = mode;
+    r->result = result;
+    r->target = (int16_t)temp_target;
+    r->controller = (uint8_t)control_mode;
+    float saved_wh = relay_control_energy_saved_wh(&relay_control);
+    r->eco_saved_dwh = isnan(saved_wh) ? CYCLE_LOG_NO_ECO : (int16_t)MAX(MIN(saved_wh * 10, INT16_MAX), INT16_MIN + 1);
+    cycle_stats_summarize(&cycle_stats, &r->summary);
+    cycle_log_append(r);
+    print_cycle_record(r);
+    checkpoint_clear();
+
+    stats_screen = true;
+    stats_page = 0;
+    timer_start(&stats_page_timer, STATS_PAGE_MS, STATS_PAGE_MS, stats_page_fired, NULL);
+}
+
+/* Formats a duration as mm:ss, or dashes if it never happened */
+static void format_mmss(char *str, size_t len, uint32_t ms) {
+    if (ms == UINT32_MAX) {
+        snprintf(str, len, "--:--");
+    } else {
+        uint32_t s = (ms + 500) / 1000;
+        snprintf(str, len, "%02lu:%02lu", (unsigned long)(s / 60 % 100), (unsigned long)(s % 60));
+    }
+}
+
+static void draw_stats_page(void) {
+    const CycleSummary *c = &last_cycle.summary;
+    char line0[17], line1[17], t[6];
+
+    switch (stats_page) {
+        case 0:
+            format_mmss(t, sizeof(t), c->preheat_ms);
+            snprintf(line0, 17, "Preheat   %5s ", t);
+            snprintf(line1, 17, "Overshoot %5.1fF", c->overshoot * (9.0f / 5.0f));
+            break;
+        case 1:
+            format_mmss(t, sizeof(t), c->settling_ms);
+            snprintf(line0, 17, "Settle    %5s ", t);
+            snprintf(line1, 17, "RMS error %5.1fF", c->rms_error * (9.0f / 5.0f));
+            break;
+        case 2:
+            snprintf(line0, 17, "In band    %3u%% ", MIN(c->in_band_pct, 100u));
+            snprintf(line1, 17, "Duty%3u%% Sw%4lu", MIN(c->duty_pct, 100u), (unsigned long)MIN(c->switches, 9999u));
+            break;
+        case 4: {
+            // Against what the fixed band would have drawn
+            float saved_wh = last_cycle.eco_saved_dwh / 10.0f;
+            float used_wh = c->duty_pct / 100.0f * c->duration_ms / 3.6e6f * ELEMENT_WATTS;
+            snprintf(line0, 17, "Eco saved%5.0fWh", saved_wh);
+            snprintf(line1, 17, "vs normal  %3d%% ", (int)roundf(100 * saved_wh / MAX(used_wh + saved_wh, 1.0f)));
+            break;
+        }
+        default:
+            snprintf(line0, 17, "Lo %4dF        ", (int)roundf(c->min_temp * (9.0f / 5.0f) + 32));
+            snprintf(line1, 17, "Hi %4dF        ", (int)roundf(c->max_temp * (9.0f / 5.0f) + 32));
+            break;
+    }
+
+    lcd_set_cursor(0, 0);
+    lcd_string(line0);
+    lcd_set_cursor(1, 0);
+    lcd_string(line1);
+}
+
 /* --- Application display and formatting helpers --- */
 static void get_settings_str(uint8_t mode, uint8_t setting_option, char* str) {
+    char t[6];
     switch (mode) {
         case 0:
-            snprintf(str, 17, "  Time: %02d:%02d   ", toast_time / 60, toast_time % 60);
+            format_mmss(t, sizeof(t), (uint32_t)toast_time * 1000);
+            snprintf(str, 17, "  Time: %5s   ", t);
             break;
         case 1:
-            if (setting_option == 0)
-                snprintf(str, 17, "   Temp: %3dF    ", bake_temp);
-            else
-                snprintf(str, 17, "   Time: %02d:%02d  ", bake_time / 60, bake_time % 60);
+            if (setting_option == 0) {
+                snprintf(str, 17, "   Temp: %3dF   ", MIN(MAX(bake_temp, 0), 999));
+            } else {
+                format_mmss(t, sizeof(t), (uint32_t)bake_time * 1000);
+                snprintf(str, 17, "   Time: %5s  ", t);
+            }
             break;
         default:
         case 2:
@@ -250,9 +1740,37 @@ static void get_settings_str(uint8_t mode, uint8_t setting_option, char* str) {
 }
 
 static void draw_lcd(uint8_t mode, uint8_t setting_option, bool running) {
+    if (sensor_fault != SENSOR_OK) {
+        char fault_str[17];
+        lcd_set_cursor(0, 0);
+        lcd_static("  SENSOR FAULT  ");
+        lcd_set_cursor(1, 0);
+        snprintf(fault_str, 17, "E%d %-13s", sensor_fault, sensor_fault_names[sensor_fault]);
+        lcd_string(fault_str);
+        return;
+    }
+
+    if (!running && resume_pending) {
+        lcd_set_cursor(0, 0);
+        lcd_static(resume_prompts[resume_point.mode % 3]);
+        lcd_set_cursor(1, 0);
+        lcd_static("START=Y  MODE=N ");
+        return;
+    }
+
+    if (!running && stats_screen) {
+        draw_stats_page();
+        return;
+    }
+
+    if (!running && diag_screen) {
+        draw_diag_screen();
+        return;
+    }
+
     if (!running) {
         lcd_set_cursor(0, 0);
-        lcd_string(modes[mode]);
+        lcd_static(modes[mode]);
 
         lcd_set_cursor(1, 0);
         char settings_str[17];
@@ -261,68 +1779,134 @@ static void draw_lcd(uint8_t mode, uint8_t setting_option, bool running) {
     } else {
         lcd_set_cursor(0, 0);
         if (mode != 1) {
-            lcd_string(running_modes[mode]);
+            lcd_static(running_modes[mode]);
         } else {
             switch (heating_stage) {
                 case 0:
-                    lcd_string(" Preheating...  ");
+                    lcd_static(" Preheating...  ");
                     break;
                 case 1:
-                    lcd_string("Ready:Press MODE");
+                    lcd_static("Ready:Press MODE");
                     break;
                 case 2:
-                    lcd_string(running_modes[mode]);
+                    lcd_static(running_modes[mode]);
             }
-            lcd_string(" Preheating...  ");
         }
 
         lcd_set_cursor(1, 0);
         float current_temp_f = current_temp * (9.0f / 5.0f) + 32;
 
-        int remaining_time = (int)round((float)time_target / 1000.0f);
+        char remaining[6];
+        format_mmss(remaining, sizeof(remaining), (uint32_t)MAX(time_target, 0));
 
-        DPRINTF("Temp %f, Time: %d\n", current_temp_f, remaining_time);
+        DPRINTF("Temp %f, Time: %s\n", current_temp_f, remaining);
         switch (mode) {
             case 0: {
                 char time_str[17];
-                snprintf(time_str, 17, "Time Left: %02d:%02d", remaining_time / 60, remaining_time % 60);
+                snprintf(time_str, 17, "Time Left: %5s", remaining);
                 lcd_string(time_str);
                 break;
             }
             case 1:
                 char status_str[17];
-                snprintf(status_str, 17, "%6.2fF    %02d:%02d", current_temp_f, remaining_time / 60, remaining_time % 60);
+                snprintf(status_str, 17, "%6.2fF    %5s", current_temp_f, remaining);
                 lcd_string(status_str);
                 break;
             case 2:
-                lcd_string("   Running...   ");
+                lcd_static("   Running...   ");
                 break;
         }
     }
 }
 
+static TimerWheelEntry lcd_refresh_timer;
+static bool lcd_refresh_due = false;
+static absolute_time_t lcd_frame_time;
+
+static void lcd_refresh_fired(TimerWheelEntry *e, void *arg) {
+    (void)e, (void)arg;
+    lcd_refresh_due = true;
+}
+
+/* The display task's check-in: the screen is current, time the next refresh */
+static void lcd_refresh_restart(void) {
+    heartbeat(TASK_DISPLAY);
+    lcd_refresh_due = false;
+    timer_start(&lcd_refresh_timer, LCD_UPDATE_MS, 0, lcd_refresh_fired, NULL);
+}
+
 /* Force an immediate LCD update and refresh tracking state */
 static void lcd_force_update(uint8_t mode, uint8_t setting_option, bool running) {
+    if (lcd_needs_init) {
+        // Resync the 4-bit interface after a bus fallback dropped nibbles
+        lcd_needs_init = false;
+        lcd_init();
+    }
+
+    absolute_time_t frame_start = get_absolute_time();
     draw_lcd(mode, setting_option, running);
-    last_lcd_update = get_absolute_time();
+    absolute_time_t encoded = get_absolute_time();
+    lcd_frame_bytes = (uint32_t)lcd_buffer_len;
+    lcd_flush();
+    lcd_encode_us = (uint32_t)absolute_time_diff_us(frame_start, encoded);
+    lcd_transfer_us = (uint32_t)absolute_time_diff_us(encoded, get_absolute_time());
+    lcd_frame_us = lcd_encode_us + lcd_transfer_us;
+    lcd_frame_max_us = MAX(lcd_frame_max_us, lcd_frame_us);
+    lcd_frame_time = get_absolute_time();
+    lcd_refresh_restart();
     last_display_seconds = running ? (int)roundf((float)time_target / 1000.0f) : -1;
 }
 
-/* Update LCD only when visible seconds change or after a timeout */
+/*
+ * Update LCD only when visible seconds change or after a timeout. Idle
+ * screens only change on input, so their refresh draws nothing and just
+ * checks in.
+ */
 static void lcd_maybe_update(uint8_t mode, uint8_t setting_option, bool running) {
+    if (!running) {
+        if (lcd_refresh_due) lcd_refresh_restart();
+        return;
+    }
     int current_display_seconds = running ? (int)roundf((float)time_target / 1000.0f) : -1;
-    int64_t since_lcd_ms = absolute_time_diff_us(last_lcd_update, get_absolute_time()) / 1000;
-    if (current_display_seconds != last_display_seconds || since_lcd_ms >= LCD_UPDATE_MS) {
+    if (board_derated) {
+        // Fewer I2C frames while the board runs hot
+        if (!lcd_refresh_due) return;
+        if (absolute_time_diff_us(lcd_frame_time, get_absolute_time()) < (int64_t)BOARD_DERATE_LCD_MS * 1000) {
+            lcd_refresh_restart();
+        } else {
+            lcd_force_update(mode, setting_option, running);
+        }
+    } else if (current_display_seconds != last_display_seconds || lcd_refresh_due) {
         lcd_force_update(mode, setting_option, running);
     }
 }
 
 static bool beeping = false;
-int64_t beep_callback(alarm_id_t id, void* user_data) {
-    DPRINTF("Stopping Beep\n");
-    gpio_put(PIN_BUZZER, 0);
-    beeping = false;
-    cancel_alarm(id);
+static int beeps_remaining = 0;
+static TimerWheelEntry beep_timer;
+
+// Alternates buzzer on/off until the requested number of beeps is done
+static void beep_toggle(TimerWheelEntry *e, void *arg) {
+    (void)arg;
+    if (gpio_get_out_level(PIN_BUZZER)) {
+        DPRINTF("Stopping Beep\n");
+        gpio_put(PIN_BUZZER, 0);
+        if (--beeps_remaining > 0) return;
+        timer_cancel(e);
+        beeping = false;
+        return;
+    }
+    gpio_put(PIN_BUZZER, 1);
+}
+
+// Beep the buzzer `count` times without blocking, with equal on and off time
+static void beep_repeat(int ms, int count) {
+    if (beeping) return;
+
+    beeping = true;
+    beeps_remaining = count;
+    gpio_put(PIN_BUZZER, 1);
+    timer_start(&beep_timer, ms, ms, beep_toggle, NULL);
 }
 
 // Beep the buzzer for x milliseconds
@@ -335,14 +1919,68 @@ static void beep(int ms, bool synchronus) {
         sleep_ms(ms);
         gpio_put(PIN_BUZZER, 0);
     } else {
-        beeping = true;
-        add_alarm_in_ms(ms, beep_callback, NULL, false);
+        beep_repeat(ms, 1);
+    }
+}
+
+/* --- Shared power budget bus --- */
+#if POWER_BUS
+static PowerBus power_bus;
+
+static void init_power_bus(void) {
+    uart_init(BUS_UART, BUS_BAUD);
+    gpio_set_function(PIN_BUS_TX, GPIO_FUNC_UART);
+    gpio_set_function(PIN_BUS_RX, GPIO_FUNC_UART);
+    gpio_set_function(PIN_BUS_DE, GPIO_FUNC_SIO);
+    gpio_set_dir(PIN_BUS_DE, GPIO_OUT);
+    gpio_put(PIN_BUS_DE, 0);
+
+    // Fold the flash unique ID into a 16-bit unit address
+    pico_unique_board_id_t id;
+    pico_get_unique_board_id(&id);
+    uint16_t unit = 0;
+    for (int i = 0; i < PICO_UNIQUE_BOARD_ID_SIZE_BYTES; i++) unit = (uint16_t)((unit << 5 | unit >> 11) ^ id.id[i]);
+    power_bus_init(&power_bus, unit, ELEMENT_WATTS, POWER_BUS_BUDGET_W, to_ms_since_boot(get_absolute_time()));
+}
+
+/* Drains received bytes and sends our broadcast when due. Never waits on peers. */
+static void power_bus_task(bool running) {
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (!running) power_bus_set_demand(&power_bus, false, 0, relay_on, now);
+
+    while (uart_is_readable(BUS_UART)) {
+        power_bus_receive(&power_bus, (uint8_t)uart_getc(BUS_UART), now);
+    }
+
+    uint8_t frame[POWER_BUS_FRAME_LEN];
+    if (power_bus_poll_tx(&power_bus, now, frame)) {
+        // Drive the RS-485 transceiver only for the length of the frame
+        gpio_put(PIN_BUS_DE, 1);
+        uart_write_blocking(BUS_UART, frame, sizeof(frame));
+        uart_tx_wait_blocking(BUS_UART);
+        gpio_put(PIN_BUS_DE, 0);
     }
 }
+#endif
+
+/**
+ * Reports the controller's demand to the power bus.
+ * @returns Whether the shared budget lets the element switch on now
+ */
+static bool power_budget_allows(bool demand) {
+#if POWER_BUS
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    power_bus_set_demand(&power_bus, demand, (float)temp_target - current_temp, relay_on, now);
+    return power_bus_may_heat(&power_bus, now);
+#else
+    (void)demand;
+    return true;
+#endif
+}
 
 /* --- Initialization split out for clarity --- */
 static void init_spi_and_sensors(void) {
-    spi_init(SPI_PORT, 4000000);
+    spi_init(SPI_PORT, SPI_BAUD);
     spi_set_format(SPI_PORT, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
     gpio_set_function(PIN_MISO, GPIO_FUNC_SPI);
     gpio_set_function(PIN_CS,   GPIO_FUNC_SIO);
@@ -350,6 +1988,11 @@ static void init_spi_and_sensors(void) {
     gpio_set_function(PIN_MOSI, GPIO_FUNC_SPI);
     gpio_set_dir(PIN_CS, GPIO_OUT);
     gpio_put(PIN_CS, 1);
+#if ELEMENT_SENSOR
+    gpio_init(PIN_CS_ELEMENT);
+    gpio_set_dir(PIN_CS_ELEMENT, GPIO_OUT);
+    gpio_put(PIN_CS_ELEMENT, 1);
+#endif
 }
 
 static void init_buttons(ButtonState *mode_btn, ButtonState *up_btn, ButtonState *down_btn, ButtonState *start_btn) {
@@ -375,6 +2018,10 @@ static void init_buttons(ButtonState *mode_btn, ButtonState *up_btn, ButtonState
 static void init_relay() {
     gpio_set_function(PIN_RELAY, GPIO_FUNC_SIO);
     gpio_set_dir(PIN_RELAY, GPIO_OUT);
+
+    relay_deadman_alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(relay_deadman_alarm, relay_deadman_fired);
+    relay_set(false);
 }
 
 static void init_buzzer() {
@@ -383,50 +2030,67 @@ static void init_buzzer() {
 }
 
 static void init_i2c_and_lcd(void) {
-    i2c_init(I2C_PORT, 400000);
+    i2c_init(I2C_PORT, i2c_rates[0]);
     gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
     gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
     gpio_pull_up(I2C_SDA);
     gpio_pull_up(I2C_SCL);
 
+    i2c_tune_rate();
     lcd_init();
     lcd_clear();
-    last_lcd_update = get_absolute_time();
     last_display_seconds = -1;
 }
 
 /* --- Main loop helpers: button handlers and timer processing --- */
-static void handle_mode_button(ButtonState *b, uint8_t *mode, uint8_t *setting_option, bool running, absolute_time_t *screen_timeout) {
+// Pending while the screen is on and idle; stopped while a cycle runs
+static TimerWheelEntry screen_timer;
+
+static void screen_timer_fired(TimerWheelEntry *e, void *arg) {
+    (void)e, (void)arg;
+    stats_screen = false;
+    diag_screen = false;
+    lcd_off();
+}
+
+static inline bool screen_timeout_pending(void) { return timer_wheel_pending(&screen_timer); }
+
+/* Keeps the screen on for another SCREEN_TIMEOUT */
+static inline void screen_timeout_restart(void) { timer_start(&screen_timer, SCREEN_TIMEOUT, 0, screen_timer_fired, NULL); }
+
+static inline void screen_timeout_stop(void) { timer_cancel(&screen_timer); }
+
+static void handle_mode_button(ButtonState *b, uint8_t *mode, uint8_t *setting_option, bool running) {
     // Wake screen on press (rising edge) — feel responsive
     if (b->cur && !b->prev) {
-        if (is_nil_time(*screen_timeout)) {
+        if (!screen_timeout_pending()) {
             lcd_on();
-            *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+            screen_timeout_restart();
             b->stale = true;
             return;
         }
-        *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+        screen_timeout_restart();
 
         beep(ACTION_BEEP_LENGTH, false);
     }
     
     // Short Press - Falling Edge
     if (!b->cur && b->prev && !running && !b->stale) {
-        if (is_nil_time(*screen_timeout)) {
+        if (!screen_timeout_pending()) {
             lcd_on();
-            *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+            screen_timeout_restart();
             return;
         }
-        *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+        screen_timeout_restart();
 
-        *mode = ++(*mode) % (sizeof(modes) / sizeof(modes[0]));
+        *mode = (*mode + 1) % (sizeof(modes) / sizeof(modes[0]));
         *setting_option = 0;
 
         lcd_force_update(*mode, *setting_option, running);
     }
 
     // Long press changes setting option in bake mode
-    if (*mode == 1 && !b->stale && b->press_time_ms >= LONG_PRESS_MS && !running) {
+    if (*mode == 1 && !b->stale && b->held && !running) {
         *setting_option = (uint8_t)((*setting_option + 1) % 2);
         b->stale = true;
 
@@ -435,26 +2099,26 @@ static void handle_mode_button(ButtonState *b, uint8_t *mode, uint8_t *setting_o
     }
 }
 
-static void handle_up_button(ButtonState *b, uint8_t mode, uint8_t *setting_option, bool running, absolute_time_t *screen_timeout) {
+static void handle_up_button(ButtonState *b, uint8_t mode, uint8_t *setting_option, bool running) {
     if (b->cur && !b->prev && !running) {
-        if (is_nil_time(*screen_timeout)) {
+        if (!screen_timeout_pending()) {
             lcd_on();
-            *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+            screen_timeout_restart();
             return;
         }
-        *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+        screen_timeout_restart();
 
         beep(ACTION_BEEP_LENGTH, false);
 
         switch (mode) {
             case 0:
-                toast_time = MIN(toast_time + TOAST_TIME_INC, 600);
+                toast_time = MIN(toast_time + TOAST_TIME_INC, TOAST_TIME_MAX);
                 break;
             case 1:
                 if (*setting_option == 0)
-                    bake_temp = MIN(bake_temp + BAKE_TEMP_INC, 500);
+                    bake_temp = MIN(bake_temp + BAKE_TEMP_INC, BAKE_TEMP_MAX);
                 else
-                    bake_time = MIN(bake_time + BAKE_TIME_INC, 1200);
+                    bake_time = MIN(bake_time + BAKE_TIME_INC, BAKE_TIME_MAX);
                 break;
         }
 
@@ -462,24 +2126,24 @@ static void handle_up_button(ButtonState *b, uint8_t mode, uint8_t *setting_opti
     }
 }
 
-static void handle_down_button(ButtonState *b, uint8_t mode, uint8_t setting_option, bool running, absolute_time_t *screen_timeout) {
+static void handle_down_button(ButtonState *b, uint8_t mode, uint8_t setting_option, bool running) {
     if (b->cur && !b->prev && !running) {
-        if (is_nil_time(*screen_timeout)) {
+        if (!screen_timeout_pending()) {
             lcd_on();
-            *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+            screen_timeout_restart();
             return;
         }
-        *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+        screen_timeout_restart();
 
         switch (mode) {
             case 0:
-                toast_time = MAX(toast_time - TOAST_TIME_INC, 30);
+                toast_time = MAX(toast_time - TOAST_TIME_INC, TOAST_TIME_MIN);
                 break;
             case 1:
                 if (setting_option == 0)
-                    bake_temp = MAX(bake_temp - BAKE_TEMP_INC, 50);
+                    bake_temp = MAX(bake_temp - BAKE_TEMP_INC, BAKE_TEMP_MIN);
                 else
-                    bake_time = MAX(bake_time - BAKE_TIME_INC, 30);
+                    bake_time = MAX(bake_time - BAKE_TIME_INC, BAKE_TIME_MIN);
                 break;
         }
         beep(ACTION_BEEP_LENGTH, false);
@@ -488,34 +2152,126 @@ static void handle_down_button(ButtonState *b, uint8_t mode, uint8_t setting_opt
     }
 }
 
-static void handle_start_button(ButtonState *b, uint8_t mode, uint8_t setting_option, bool *running, absolute_time_t *screen_timeout) {
+static void handle_start_button(ButtonState *b, uint8_t mode, uint8_t setting_option, bool *running) {
     if (b->cur && !b->prev) {
-        if (!*running && is_nil_time(*screen_timeout)) {
+        // Only a plain press of an awake, idle oven starts a cycle on release
+        b->stale = true;
+        if (!*running && !screen_timeout_pending()) {
             lcd_on();
-            *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+            screen_timeout_restart();
             return;
         }
-        if (!*running) *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
-
-        *running = !*running;
-        beep(*running ? START_BEEP_LENGTH : ACTION_BEEP_LENGTH, false);
+        if (!*running) screen_timeout_restart();
 
-        if (*running) {
-            *screen_timeout = nil_time;
-            start_time = get_absolute_time();
-            temp_target = (mode == 1) ? (int)((float)(bake_temp - 32) * (5.0f / 9.0f)) : 260;
-            time_target = ((mode == 0) ? toast_time : bake_time) * 1000; // convert seconds -> ms
-            heating_stage = mode == 0 ? 2 : 0; // Skip preheat for toast operation
-        } else {
-            DPRINTF("Button stopped\n");
-            gpio_put(PIN_RELAY, 0);
+        // First press after a sensor fault only acknowledges it
+        if (sensor_fault != SENSOR_OK) {
+            beep(ACTION_BEEP_LENGTH, false);
+            clear_sensor_fault();
             lcd_force_update(mode, setting_option, *running);
-            *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+            return;
+        }
+
+        if (!*running) {
+            b->stale = false;
+            return;
+        }
+
+        // Stop on the press
+        *running = false;
+        beep(ACTION_BEEP_LENGTH, false);
+        DPRINTF("Button stopped\n");
+        report_sensor_rates();
+        relay_set(false);
+        finish_cycle(mode, CYCLE_STOPPED);
+        lcd_force_update(mode, setting_option, *running);
+        screen_timeout_restart();
+        return;
+    }
+
+    // Start on the release, which leaves START free to be held for a preset chord
+    if (!b->cur && b->prev && !b->stale && !*running) {
+        *running = true;
+        beep(START_BEEP_LENGTH, false);
+
+        screen_timeout_stop();
+        start_time = get_absolute_time();
+        request_temp_update();
+        checkpoint_prepare();
+        stats_screen = false;
+        temp_target = mode_temp_target(mode);
+        time_target = ((mode == 0) ? toast_time : bake_time) * 1000; // convert seconds -> ms
+        heating_stage = mode == 0 ? 2 : 0; // Skip preheat for toast operation
+        heat_demand = false;
+        relay_control_reset(&relay_control, current_temp);
+        cycle_stats_begin(&cycle_stats, (float)temp_target, TEMP_HYSTERESIS);
+    }
+}
+
+/*
+ * START + MODE/UP/DOWN. The chord is taken as soon as the second button
+ * goes down with START already held, and both presses are swallowed so
+ * neither button's own handler sees them. Releasing it recalls the slot;
+ * holding it past PRESET_SAVE_MS saves to the slot instead.
+ */
+static int preset_chord = -1; // Slot whose button is down, or -1
+static bool preset_chord_saved = false;
+
+static void handle_preset_chord(ButtonState *start, ButtonState *slot_btns[PRESET_SLOTS], uint8_t *mode,
+                                uint8_t *setting_option, bool running) {
+    if (preset_chord >= 0) {
+        ButtonState *b = slot_btns[preset_chord];
+        if (!b->cur) {
+            if (!preset_chord_saved) {
+                bool recalled = preset_recall((uint8_t)preset_chord, mode);
+                if (recalled) *setting_option = 0;
+                beep(recalled ? ACTION_BEEP_LENGTH : COMPLETE_BEEP_LENGTH, false);
+                lcd_force_update(*mode, *setting_option, running);
+            }
+            preset_chord = -1;
+        } else if (!preset_chord_saved && b->held) {
+            preset_save((uint8_t)preset_chord, *mode);
+            preset_chord_saved = true;
+            beep_repeat(ACTION_BEEP_LENGTH, 2);
+        }
+        screen_timeout_restart();
+        return;
+    }
+
+    if (running || !start->cur || start->stale || !screen_timeout_pending()) return;
+    for (int i = 0; i < PRESET_SLOTS; i++) {
+        if (slot_btns[i]->cur && !slot_btns[i]->prev) {
+            button_consume(slot_btns[i]);
+            button_consume(start);
+            button_retime_hold(slot_btns[i], PRESET_SAVE_MS);
+            preset_chord = i;
+            preset_chord_saved = false;
+            screen_timeout_restart();
+            return;
+        }
+    }
+}
+
+/*
+ * Closes a screen that any press dismisses. The press is consumed so it
+ * doesn't also act on whatever the screen was covering.
+ */
+static void dismiss_on_any_press(bool *screen, ButtonState *btns[4], uint8_t mode, uint8_t setting_option,
+                                 bool running) {
+    if (!*screen) return;
+    for (int i = 0; i < 4; i++) {
+        if (btns[i]->cur && !btns[i]->prev) {
+            *screen = false;
+            button_consume(btns[i]);
+            screen_timeout_restart();
+            lcd_force_update(mode, setting_option, running);
+            return;
         }
     }
 }
 
-static void process_cycle(bool *running, uint8_t mode, uint8_t setting_option, absolute_time_t* screen_timeout, ButtonState* modeBtn) {
+static absolute_time_t last_control_step = 0;
+
+static void process_cycle(bool *running, uint8_t mode, uint8_t setting_option, ButtonState* modeBtn) {
     prev_heating_stage = heating_stage;
     if (heating_stage == 0 && current_temp >= temp_target - TEMP_HYSTERESIS) {
         heating_stage = 1;
@@ -527,84 +2283,332 @@ static void process_cycle(bool *running, uint8_t mode, uint8_t setting_option, a
         heating_stage = 2;
     }
 
-    if (current_temp <= temp_target - TEMP_HYSTERESIS) {
-        gpio_put(PIN_RELAY, 1);
-    } else if (current_temp >= temp_target + TEMP_HYSTERESIS) {
-        gpio_put(PIN_RELAY, 0);
+    absolute_time_t now = get_absolute_time();
+    float dt_s = is_nil_time(last_control_step) ? 0 : MIN((float)absolute_time_diff_us(last_control_step, now) / 1e6f, 1.0f);
+    last_control_step = now;
+
+    // Shared with the host benchmark (host/); measure controller changes there
+    uint32_t start = time_us_32();
+    // The cycle's end is only known once its timer runs
+    uint32_t remaining_ms = heating_stage == 2 ? (uint32_t)MAX(time_target, 0) : MPC_NO_END;
+    heat_demand = relay_control_update(&relay_control, to_ms_since_boot(now), (float)temp_target, 0,
+                                       (float)temp_target, remaining_ms, current_temp, element_temp, dt_s);
+    if (relay_control.mpc_planned) {
+        mpc_step_us = time_us_32() - start;
+        mpc_step_max_us = MAX(mpc_step_max_us, mpc_step_us);
     }
+    // Re-assert the relay every pass to keep the dead-man alarm from firing
+    // Both gates keep their own books every pass, so evaluate both
+    bool bus_allows = power_budget_allows(heat_demand);
+    bool board_allows = board_power_allows(heat_demand);
+    relay_set(bus_allows && board_allows);
+    relay_control_applied(&relay_control, relay_on);
     
     if (time_target <= 0) {
-        gpio_put(PIN_RELAY, 0);
+        relay_set(false);
         *running = false;
+        finish_cycle(mode, CYCLE_COMPLETED);
         lcd_force_update(mode, setting_option, *running);
 
         DPRINTF("Completed Cycle %d\n");
-        beep(COMPLETE_BEEP_LENGTH, true);
-        sleep_ms(COMPLETE_BEEP_LENGTH);
-        beep(COMPLETE_BEEP_LENGTH, true);
-        sleep_ms(COMPLETE_BEEP_LENGTH);
-        beep(COMPLETE_BEEP_LENGTH, true);
+        report_sensor_rates();
+        beep_repeat(COMPLETE_BEEP_LENGTH, COMPLETE_BEEP_COUNT);
+
+        screen_timeout_restart();
+    }
+}
+
+/* Switches the relay controller, forgetting anything learned */
+static void set_control_mode(ControlMode mode) {
+    static const RelayControlConfig config = {
+        .hysteresis = TEMP_HYSTERESIS,
+        .element_max = ELEMENT_MAX_TEMP_C,
+        .element_hysteresis = ELEMENT_HYSTERESIS,
+        .cascade_kp = CASCADE_KP,
+        .cascade_ki = CASCADE_KI,
+        .model_element_j_per_c = MODEL_ELEMENT_J_PER_C,
+        .model_cavity_j_per_c = MODEL_CAVITY_J_PER_C,
+        .model_coupling_w_per_c = MODEL_COUPLING_W_PER_C,
+        .model_loss_w_per_c = MODEL_LOSS_W_PER_C,
+        .watts = ELEMENT_WATTS,
+        .switch_penalty = MPC_SWITCH_PENALTY,
+        .eco_energy_penalty = ECO_ENERGY_PENALTY,
+        .ambient = MODEL_AMBIENT_C,
+    };
+    control_mode = mode;
+    relay_control_init(&relay_control, mode, &config, current_temp);
+}
+
+/* --- USB command console --- */
+#define USB_LINE_MAX 48
+static char usb_line[USB_LINE_MAX];
+static int usb_line_len = 0;
+
+static void print_event_log(void) {
+    uint32_t first = event_log_count > LOG_SIZE ? event_log_count - LOG_SIZE : 0;
+    for (uint32_t i = first; i < event_log_count; i++) {
+        print_event(&event_log[i % LOG_SIZE]);
+    }
+}
 
-        *screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+static void handle_command(const char *line) {
+    if (strcmp(line, "status") == 0) {
+        print_supervisor_status();
+#if POWER_BUS
+        uint32_t now = to_ms_since_boot(get_absolute_time());
+        printf("BUS unit %04x peers %d granted %d rx %lu bad %lu\n", power_bus.self.unit,
+               power_bus_active_peers(&power_bus, now), power_bus_may_heat(&power_bus, now),
+               (unsigned long)power_bus.frames_rx, (unsigned long)power_bus.frames_bad);
+#endif
+        int64_t now_wall_ms = wall_time_ms(to_ms_since_boot(get_absolute_time()));
+        printf("TIME wall %lld ms rtt %lu us drift %ld ppb samples %lu rejected %lu\n", (long long)now_wall_ms,
+               (unsigned long)time_sync.ref_rtt_us, (long)time_sync.drift_ppb,
+               (unsigned long)time_sync.samples, (unsigned long)time_sync.rejected);
+        printf("SENSOR fault E%d\n", sensor_fault);
+#if ELEMENT_SENSOR
+        printf("ELEMENT %.2fC\n", element_temp);
+#endif
+        printf("BOARD %.1fC%s%s, clock %lu kHz\n", board_temp, board_derated ? " derated" : "", board_hot ? " shutdown" : "",
+               (unsigned long)(clock_get_hz(clk_sys) / 1000));
+        report_sensor_rates();
+        printf("RELAY %s deadman trips %lu\n", relay_on ? "on" : "off", (unsigned long)relay_deadman_trips);
+        printf("I2C %lu Hz errors %lu, LCD frame %lu us max %lu us\n", (unsigned long)i2c_baud, (unsigned long)i2c_errors,
+               (unsigned long)lcd_frame_us, (unsigned long)lcd_frame_max_us);
+        printf("LCD encode %lu us, transfer %lu us, %lu bytes, %u bytes per write\n", (unsigned long)lcd_encode_us,
+               (unsigned long)lcd_transfer_us, (unsigned long)lcd_frame_bytes, lcd_write_len);
+        print_timer_status();
+    } else if (strcmp(line, "log") == 0) {
+        print_event_log();
+    } else if (strcmp(line, "cycles") == 0) {
+        print_cycle_log();
+    } else if (strcmp(line, "presets") == 0) {
+        print_presets();
+    } else if (strcmp(line, "bench") == 0) {
+        print_bench();
+    } else if (strcmp(line, "ctrl") == 0 || strncmp(line, "ctrl ", 5) == 0) {
+        // "ctrl" reports, "ctrl <mode>" switches and forgets what was learned
+        if (line[4]) {
+            int m = 0;
+            while (m < CONTROL_MODE_COUNT && strcmp(line + 5, control_mode_names[m]) != 0) m++;
+            if (m == CONTROL_MODE_COUNT || (m == CONTROL_CASCADE && !ELEMENT_SENSOR)) {
+                printf("ERR unknown controller\n");
+                return;
+            }
+            set_control_mode((ControlMode)m);
+        }
+        if (control_mode == CONTROL_CASCADE) {
+            printf("CONTROLLER cascade element %.2fC target %.2fC offset %.2fC\n", element_temp,
+                   relay_control.cascade.element_target, relay_control.cascade.integral);
+        } else if (control_mode == CONTROL_MPC || control_mode == CONTROL_ECO) {
+            printf("CONTROLLER %s element ~%.1fC plan %s %us cost %lu, step %lu us max %lu us",
+                   control_mode_names[control_mode], relay_control.mpc.element / (float)(1 << MPC_TEMP_SHIFT), relay_control.mpc.plan_on_first ? "on" : "off",
+                   relay_control.mpc.plan_switch * MPC_QUANTUM_MS / 1000, (unsigned long)relay_control.mpc.cost,
+                   (unsigned long)mpc_step_us, (unsigned long)mpc_step_max_us);
+            if (control_mode == CONTROL_ECO) printf(", saved %.1f Wh", relay_control_energy_saved_wh(&relay_control));
+            printf("\n");
+        } else {
+            printf("CONTROLLER %s on %.2fC off %.2fC adaptations %lu\n", control_mode_names[control_mode],
+                   relay_control.band.on_offset, relay_control.band.off_offset,
+                   (unsigned long)relay_control.band.adaptations);
+        }
+    } else if (strncmp(line, "sync ", 5) == 0) {
+        // Reply before anything else so the round trip stays short
+        uint64_t now_us = time_us_64();
+        int64_t host_send_us = strtoll(line + 5, NULL, 10);
+        time_sync_ping(&time_sync, host_send_us, now_us);
+        printf("SYNC %lld %llu\n", (long long)host_send_us, (unsigned long long)now_us);
+    } else if (strncmp(line, "time ", 5) == 0) {
+        char *end;
+        int64_t host_send_us = strtoll(line + 5, &end, 10);
+        int64_t host_recv_us = strtoll(end, NULL, 10);
+        bool used = time_sync_complete(&time_sync, host_send_us, host_recv_us);
+        printf("TIME %s rtt %lu us drift %ld ppb\n", used ? "ok" : "ignored",
+               (unsigned long)(host_recv_us - host_send_us), (long)time_sync.drift_ppb);
+    } else if (line[0]) {
+        printf("ERR unknown command\n");
     }
 }
 
+/* Drains pending USB input without blocking and runs complete lines */
+static void usb_task(void) {
+    if (time_sync_due(&time_sync, time_us_64())) printf("TIME?\n");
+
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if (c == '\r' || c == '\n') {
+            usb_line[usb_line_len] = '\0';
+            handle_command(usb_line);
+            usb_line_len = 0;
+        } else if (usb_line_len < USB_LINE_MAX - 1) {
+            usb_line[usb_line_len++] = (char)c;
+        }
+    }
+    heartbeat(TASK_USB);
+}
+
+// Paces the main loop's passes
+static TimerWheelEntry loop_timer;
+static bool loop_pass_due = false;
+
+static void loop_timer_fired(TimerWheelEntry *e, void *arg) {
+    (void)e, (void)arg;
+    loop_pass_due = true;
+}
+
 int main(void) {
+#if USB_MSC_EXPORT
+    usb_export_init();
+#endif
     stdio_init_all();
 
+    time_sync_init(&time_sync);
+    init_timers();
+    set_control_mode(CONTROL_MODE_DEFAULT);
+
     // Initialize peripherals
     init_spi_and_sensors();
 
     ButtonState mode_btn, up_btn, down_btn, start_btn;
     init_buttons(&mode_btn, &up_btn, &down_btn, &start_btn);
     init_relay();
+    init_board_temp();
     init_buzzer();
     init_i2c_and_lcd();
 
+    bench_load();
+    cycle_log_boot();
+    preset_boot();
+    if (SELF_BENCHMARK || !gpio_get(PIN_BTN_DOWN)) {
+        run_self_benchmark();
+        // Don't let the held button act as a press
+        button_update(&down_btn);
+        button_consume(&down_btn);
+    }
+#if POWER_BUS
+    init_power_bus();
+#endif
+    init_supervisor();
+
     uint8_t mode = 0;
     uint8_t setting_option = 0; // for bake mode: 0 = temp, 1 = time
     bool running = false;
-    absolute_time_t screen_timeout = make_timeout_time_ms(SCREEN_TIMEOUT);
+    screen_timeout_restart();
+
+    // Take a reading before deciding whether an interrupted cycle can resume
+    update_temp(running, true);
+    checkpoint_boot();
 
     lcd_force_update(mode, setting_option, running);
+    printf("I2C %lu Hz, LCD frame %lu us\n", (unsigned long)i2c_baud, (unsigned long)lcd_frame_us);
 
     absolute_time_t last_time = get_absolute_time();
+    timer_start(&loop_timer, LOOP_DELAY_MS, LOOP_DELAY_MS, loop_timer_fired, NULL);
 
     while (true) {
         absolute_time_t loop_start = get_absolute_time();
-        sleep_ms(LOOP_DELAY_MS);
-        int32_t delta_us = absolute_time_diff_us(loop_start, get_absolute_time());
-        int32_t delta_ms = (int32_t)((delta_us + 500) / 1000);
-
-        if (!is_nil_time(screen_timeout) && absolute_time_min(get_absolute_time(), screen_timeout) == screen_timeout) {
-            screen_timeout = nil_time;
-            lcd_off();
+        // Sleep until the next pass, running any other timeouts that fall due
+        while (!loop_pass_due) timers_wait();
+        loop_pass_due = false;
+        absolute_time_t loop_end_sleep = get_absolute_time();
+
+        absolute_time_t now = get_absolute_time();
+        int64_t loop_us = absolute_time_diff_us(last_time, now);
+        sensor_time_us[running] += (uint64_t)loop_us;
+        last_time = now;
+
+        SensorFault prev_fault = sensor_fault;
+        update_temp(running, screen_timeout_pending() || running);
+#if ELEMENT_SENSOR
+        update_element_temp(running);
+#endif
+        board_temp_task();
+        if (sensor_fault != SENSOR_OK && prev_fault == SENSOR_OK) {
+            // Relay is already off; abort any cycle and show the fault code
+            if (running) finish_cycle(mode, CYCLE_FAULT);
+            running = false;
+            lcd_on();
+            lcd_force_update(mode, setting_option, running);
+            beep(COMPLETE_BEEP_LENGTH, false);
+            screen_timeout_restart();
         }
 
-        update_temp();
+        button_update(&mode_btn);
+        button_update(&up_btn);
+        button_update(&down_btn);
+        button_update(&start_btn);
+
+        // Power-fail resume prompt: START resumes, MODE or timeout discards
+        if (resume_pending) {
+            if (start_btn.cur && !start_btn.prev) {
+                button_consume(&start_btn);
+                timer_cancel(&resume_timer);
+                resume_pending = false;
+                mode = resume_point.mode;
+                setting_option = 0;
+                toast_time = resume_point.toast_time;
+                bake_time = resume_point.bake_time;
+                bake_temp = resume_point.bake_temp;
+                temp_target = mode_temp_target(mode);
+                time_target = resume_point.time_target;
+                heating_stage = resume_point.stage;
+                heat_demand = false;
+                relay_control_reset(&relay_control, current_temp);
+                start_time = get_absolute_time();
+                request_temp_update();
+                checkpoint_prepare();
+                cycle_stats_begin(&cycle_stats, (float)temp_target, TEMP_HYSTERESIS);
+                running = true;
+                screen_timeout_stop();
+                beep(START_BEEP_LENGTH, false);
+                lcd_force_update(mode, setting_option, running);
+            } else if ((mode_btn.cur && !mode_btn.prev) || !timer_wheel_pending(&resume_timer)) {
+                button_consume(&mode_btn);
+                timer_cancel(&resume_timer);
+                resume_pending = false;
+                checkpoint_clear();
+                lcd_force_update(mode, setting_option, running);
+            }
+        }
 
-        // Update buttons with the measured delta
-        button_update(&mode_btn, delta_ms);
-        button_update(&up_btn, delta_ms);
-        button_update(&down_btn, delta_ms);
-        button_update(&start_btn, delta_ms);
+        // Any press dismisses the boot diagnostics and post-cycle statistics screens
+        ButtonState *all_btns[] = {&mode_btn, &up_btn, &down_btn, &start_btn};
+        dismiss_on_any_press(&diag_screen, all_btns, mode, setting_option, running);
+        dismiss_on_any_press(&stats_screen, all_btns, mode, setting_option, running);
+        if (stats_screen && stats_page_turned) {
+            stats_page_turned = false;
+            lcd_force_update(mode, setting_option, running);
+        }
 
         // Handle events
-        handle_mode_button(&mode_btn, &mode, &setting_option, running, &screen_timeout);
-        handle_up_button(&up_btn, mode, &setting_option, running, &screen_timeout);
-        handle_down_button(&down_btn, mode, setting_option, running, &screen_timeout);
-        handle_start_button(&start_btn, mode, setting_option, &running, &screen_timeout);
+        ButtonState *preset_btns[PRESET_SLOTS] = {&mode_btn, &up_btn, &down_btn};
+        handle_preset_chord(&start_btn, preset_btns, &mode, &setting_option, running);
+        handle_mode_button(&mode_btn, &mode, &setting_option, running);
+        handle_up_button(&up_btn, mode, &setting_option, running);
+        handle_down_button(&down_btn, mode, setting_option, running);
+        handle_start_button(&start_btn, mode, setting_option, &running);
+
+        // Update LCD periodically or when needed
+        lcd_maybe_update(mode, setting_option, running);
 
         // Apply timer countdown when running
         if (running) {
-            // Update LCD periodically or when needed
-            lcd_maybe_update(mode, setting_option, running);
-            
-            process_cycle(&running, mode, setting_option, &screen_timeout, &mode_btn);
+            cycle_stats_sample(&cycle_stats, (uint32_t)((loop_us + 500) / 1000), current_temp, relay_on);
+            process_cycle(&running, mode, setting_option, &mode_btn);
             int32_t delta_us = absolute_time_diff_us(loop_start, get_absolute_time());
             int32_t delta_ms = (int32_t)((delta_us + 500) / 1000);
 
             time_target -= delta_ms * (heating_stage == 2);
+            checkpoint_task(running, mode);
         }
+
+        publish_control_status(running);
+
+#if POWER_BUS
+        power_bus_task(running);
+#endif
+        usb_task();
+        heartbeat(TASK_CONTROL);
+
+        bench_loop_pass((uint32_t)absolute_time_diff_us(loop_end_sleep, get_absolute_time()));
     }
 }
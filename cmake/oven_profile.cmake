@@ -0,0 +1,123 @@
+# Generates oven_profile.h from profiles/<OVEN_PROFILE>.profile.
+#
+# The profile is a flat KEY = value file. Every key below must be present
+# and no others are accepted, so a typo fails the configure step instead of
+# silently falling back to a default. Range and pin checks live in
+# oven_profile.h.in as static assertions.
+
+set(OVEN_PROFILE_KEYS
+    NAME
+    PIN_MISO PIN_CS PIN_SCK PIN_MOSI I2C_SDA I2C_SCL
+    PIN_RELAY PIN_BTN_MODE PIN_BTN_UP PIN_BTN_DOWN PIN_BTN_START PIN_BUZZER
+    POWER_BUS PIN_BUS_TX PIN_BUS_RX PIN_BUS_DE ELEMENT_WATTS POWER_BUS_BUDGET_W
+    MAX_TEMP_C
+    TOAST_TEMP_C TOAST_TIME_DEFAULT TOAST_TIME_MIN TOAST_TIME_MAX TOAST_TIME_INC
+    BAKE_TIME_DEFAULT BAKE_TIME_MIN BAKE_TIME_MAX BAKE_TIME_INC
+    BAKE_TEMP_DEFAULT BAKE_TEMP_MIN BAKE_TEMP_MAX BAKE_TEMP_INC
+    TEMP_HYSTERESIS
+    ELEMENT_SENSOR PIN_CS_ELEMENT ELEMENT_MAX_TEMP_C ELEMENT_HYSTERESIS CASCADE_KP CASCADE_KI
+    MODEL_ELEMENT_J_PER_C MODEL_CAVITY_J_PER_C MODEL_COUPLING_W_PER_C MODEL_LOSS_W_PER_C MPC_SWITCH_PENALTY
+    ECO_ENERGY_PENALTY
+)
+
+set(OVEN_PROFILE_TEMPLATE ${CMAKE_CURRENT_LIST_DIR}/oven_profile.h.in)
+
+# Keys that name a GPIO; each pair gets a static assertion against sharing.
+set(OVEN_PROFILE_PIN_KEYS
+    PIN_MISO PIN_CS PIN_SCK PIN_MOSI I2C_SDA I2C_SCL
+    PIN_RELAY PIN_BTN_MODE PIN_BTN_UP PIN_BTN_DOWN PIN_BTN_START PIN_BUZZER
+    PIN_BUS_TX PIN_BUS_RX PIN_BUS_DE PIN_CS_ELEMENT
+)
+
+# Pins only wired when a feature is fitted, as PIN=FLAG. Their assertions
+# only hold with the flag set, so an unused pin may overlap anything.
+set(OVEN_PROFILE_PIN_FEATURES
+    PIN_BUS_TX=POWER_BUS PIN_BUS_RX=POWER_BUS PIN_BUS_DE=POWER_BUS
+    PIN_CS_ELEMENT=ELEMENT_SENSOR
+)
+
+# Keys with a fractional value. Each also gets <KEY>_MILLI in thousandths,
+# as _Static_assert only takes integer constant expressions.
+set(OVEN_PROFILE_DECIMAL_KEYS
+    TEMP_HYSTERESIS ELEMENT_HYSTERESIS CASCADE_KP CASCADE_KI
+    MODEL_ELEMENT_J_PER_C MODEL_CAVITY_J_PER_C MODEL_COUPLING_W_PER_C MODEL_LOSS_W_PER_C
+)
+
+# The "!FLAG || " prefix that limits a pin's assertions to its feature
+function(oven_profile_pin_guard pin out)
+    set(guard "")
+    foreach(pair IN LISTS OVEN_PROFILE_PIN_FEATURES)
+        if (pair MATCHES "^${pin}=(.+)$")
+            set(guard "!${CMAKE_MATCH_1} || ")
+        endif()
+    endforeach()
+    set(${out} "${guard}" PARENT_SCOPE)
+endfunction()
+
+function(oven_profile_generate profile_file out_dir)
+    if (NOT EXISTS ${profile_file})
+        message(FATAL_ERROR "Oven profile ${profile_file} does not exist")
+    endif()
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${profile_file})
+
+    file(STRINGS ${profile_file} lines)
+    foreach(line IN LISTS lines)
+        string(REGEX REPLACE "^[ \t]*#.*$" "" line "${line}")
+        string(STRIP "${line}" line)
+        if (line STREQUAL "")
+            continue()
+        endif()
+        if (NOT line MATCHES "^([A-Z0-9_]+)[ \t]*=[ \t]*(.+)$")
+            message(FATAL_ERROR "${profile_file}: cannot parse '${line}'")
+        endif()
+        set(key ${CMAKE_MATCH_1})
+        set(value "${CMAKE_MATCH_2}")
+        if (NOT key IN_LIST OVEN_PROFILE_KEYS)
+            message(FATAL_ERROR "${profile_file}: unknown key ${key}")
+        endif()
+        if (DEFINED PROFILE_${key})
+            message(FATAL_ERROR "${profile_file}: ${key} set twice")
+        endif()
+        set(PROFILE_${key} "${value}")
+    endforeach()
+
+    foreach(key IN LISTS OVEN_PROFILE_KEYS)
+        if (NOT DEFINED PROFILE_${key})
+            message(FATAL_ERROR "${profile_file}: missing key ${key}")
+        endif()
+    endforeach()
+
+    foreach(key IN LISTS OVEN_PROFILE_DECIMAL_KEYS)
+        if (NOT PROFILE_${key} MATCHES "^(-?)([0-9]+)(\\.([0-9]?[0-9]?[0-9]?))?$")
+            message(FATAL_ERROR "${profile_file}: ${key} must be a number with at most three decimals")
+        endif()
+        set(sign "${CMAKE_MATCH_1}")
+        set(whole "${CMAKE_MATCH_2}")
+        string(SUBSTRING "${CMAKE_MATCH_4}000" 0 3 frac)
+        math(EXPR milli "${whole} * 1000 + 1${frac} - 1000")
+        set(PROFILE_${key}_MILLI "${sign}${milli}")
+    endforeach()
+
+    set(PROFILE_PIN_ASSERTS "")
+    set(remaining ${OVEN_PROFILE_PIN_KEYS})
+    foreach(a IN LISTS OVEN_PROFILE_PIN_KEYS)
+        list(REMOVE_AT remaining 0)
+        oven_profile_pin_guard(${a} guard_a)
+        set(range "${a} >= 0 && ${a} <= 29")
+        if (guard_a)
+            set(range "${guard_a}(${range})")
+        endif()
+        string(APPEND PROFILE_PIN_ASSERTS "_Static_assert(${range}, \"${a} is not an RP2040 GPIO\");\n")
+        foreach(b IN LISTS remaining)
+            oven_profile_pin_guard(${b} guard_b)
+            if (guard_a STREQUAL guard_b)
+                set(guard_b "")
+            endif()
+            string(APPEND PROFILE_PIN_ASSERTS
+                "_Static_assert(${guard_a}${guard_b}${a} != ${b}, \"${a} and ${b} share a GPIO\");\n")
+        endforeach()
+    endforeach()
+
+    get_filename_component(PROFILE_SOURCE ${profile_file} NAME)
+    configure_file(${OVEN_PROFILE_TEMPLATE} ${out_dir}/oven_profile.h @ONLY)
+endfunction()
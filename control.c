@@ -0,0 +1,108 @@
+#include "control.h"
+
+#include <math.h>
+
+const char *const control_mode_names[CONTROL_MODE_COUNT] = {"fixed", "adaptive", "cascade", "mpc", "eco"};
+
+void bang_bang_init(BangBang *c, ControlMode mode, float hysteresis) {
+    *c = (BangBang){0};
+    c->mode = mode;
+    c->hysteresis = hysteresis;
+    c->on_offset = hysteresis;
+    c->off_offset = hysteresis;
+}
+
+void bang_bang_reset(BangBang *c) {
+    c->demand = false;
+    c->clean_switches = 0;
+}
+
+static float clampf(float v, float lo, float hi) {
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+/*
+ * Moves one threshold so the next extreme lands on target +/- hysteresis.
+ * The on threshold has to stay below the off threshold; if both lags
+ * outgrow the band the swing widens rather than the relay chattering.
+ */
+static void adapt(BangBang *c, float target, bool peak) {
+    if (c->clean_switches < CONTROL_ADAPT_AFTER) return;
+    if (peak) {
+        float miss = (c->extreme - target) - c->hysteresis;
+        c->off_offset = clampf(c->off_offset - CONTROL_ADAPT_GAIN * miss,
+                               CONTROL_MIN_GAP - c->on_offset, CONTROL_ADAPT_LIMIT);
+    } else {
+        float miss = (target - c->extreme) - c->hysteresis;
+        c->on_offset = clampf(c->on_offset - CONTROL_ADAPT_GAIN * miss,
+                              CONTROL_MIN_GAP - c->off_offset, CONTROL_ADAPT_LIMIT);
+    }
+    c->adaptations++;
+}
+
+bool bang_bang_update(BangBang *c, float target, float temp) {
+    if (c->mode == CONTROL_FIXED_BAND) {
+        if (temp <= target - c->hysteresis) {
+            c->demand = true;
+        } else if (temp >= target + c->hysteresis) {
+            c->demand = false;
+        }
+        return c->demand;
+    }
+
+    // A new target makes the extremes so far meaningless
+    if (target != c->target) {
+        c->target = target;
+        c->clean_switches = 0;
+    }
+
+    // Track the extreme of the current half-cycle
+    if (c->demand ? temp < c->extreme : temp > c->extreme) c->extreme = temp;
+
+    if (!c->demand && temp <= target - c->on_offset) {
+        // A steady cycle switches on as it crosses the threshold. Starting
+        // far below it is a long burn, whose overshoot is no guide, and the
+        // relay cycle after it still carries its heat.
+        if (temp < target - c->on_offset - c->hysteresis) {
+            c->clean_switches = 0;
+        } else if (c->clean_switches < CONTROL_ADAPT_AFTER) {
+            c->clean_switches++;
+        }
+        adapt(c, target, true);   // The peak after the last switch-off is final
+        c->demand = true;
+        c->extreme = temp;
+    } else if (c->demand && temp >= target + c->off_offset) {
+        adapt(c, target, false);  // Likewise the trough after the last switch-on
+        c->demand = false;
+        c->extreme = temp;
+    }
+    return c->demand;
+}
+
+void cascade_init(Cascade *c, float kp, float ki, float element_max, float element_hysteresis) {
+    *c = (Cascade){0};
+    c->kp = kp;
+    c->ki = ki;
+    c->element_max = element_max;
+    bang_bang_init(&c->inner, CONTROL_FIXED_BAND, element_hysteresis);
+}
+
+void cascade_reset(Cascade *c) {
+    bang_bang_reset(&c->inner);
+}
+
+bool cascade_update(Cascade *c, float target, float cavity, float element, float dt_s) {
+    float error = target - cavity;
+    float demand = target + c->kp * error + c->integral;
+
+    // Integrate only while the inner loop is keeping up with its target, so
+    // a preheat the element can't follow doesn't wind up an offset that
+    // overshoots once the cavity arrives
+    bool tracking = element >= c->element_target - 2 * c->inner.hysteresis;
+    if (tracking && demand < c->element_max) {
+        c->integral += c->ki * error * dt_s;
+    }
+
+    c->element_target = clampf(target + c->kp * error + c->integral, target, c->element_max);
+    return bang_bang_update(&c->inner, c->element_target, element);
+}
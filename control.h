@@ -0,0 +1,102 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * On/off element control for the relay.
+ *
+ * CONTROL_FIXED_BAND switches on at target - hysteresis and off at
+ * target + hysteresis. Thermal lag carries the temperature past both
+ * thresholds, so in practice the swing is wider than the band and, because
+ * heating and cooling lags differ, off-centre.
+ *
+ * CONTROL_ADAPTIVE_BAND keeps separate on and off thresholds and, after
+ * every relay cycle, moves each by a fraction of how far the observed
+ * extreme missed target +/- hysteresis: the off threshold by the peak that
+ * followed it, the on threshold by the trough. The learned offsets are the
+ * oven's lags, so they are kept across cycles.
+ *
+ * A long burn (a switch-on well below the on threshold, as in preheat or
+ * after the target rises) and any target change disturb the extremes that
+ * follow, so adapting waits until one full relay cycle has completed after
+ * the last of them.
+ *
+ * No SDK dependencies, shared with host benchmarks. Celsius throughout.
+ */
+
+#define CONTROL_ADAPT_GAIN   0.6f  // Fraction of each miss corrected per relay cycle
+#define CONTROL_ADAPT_LIMIT  30.0f // Largest threshold offset
+#define CONTROL_MIN_GAP      0.5f  // Least distance between on and off thresholds
+#define CONTROL_ADAPT_AFTER  2     // Clean switch-ons before an extreme is trusted
+#define CONTROL_CASCADE_I_BAND 10.0f // Cavity error inside which the cascade integrates
+
+typedef enum ControlMode {
+    CONTROL_FIXED_BAND = 0,
+    CONTROL_ADAPTIVE_BAND,
+    CONTROL_CASCADE, // Runs a Cascade rather than a BangBang
+    CONTROL_MPC,     // Runs an Mpc (mpc.h)
+    CONTROL_ECO,     // Runs an Mpc with economy on
+    CONTROL_MODE_COUNT,
+} ControlMode;
+
+typedef struct BangBang {
+    ControlMode mode;
+    float hysteresis;
+    float on_offset;   // Switch on at target - on_offset
+    float off_offset;  // Switch off at target + off_offset
+    bool demand;
+
+    float extreme;     // Peak since switching off, or trough since switching on
+    float target;      // What the current extremes are measured against
+    uint8_t clean_switches; // Switch-ons since the last long burn or target change
+    uint32_t adaptations;
+} BangBang;
+
+extern const char *const control_mode_names[CONTROL_MODE_COUNT];
+
+void bang_bang_init(BangBang *c, ControlMode mode, float hysteresis);
+
+/* Starts a new cycle. Learned offsets are kept. */
+void bang_bang_reset(BangBang *c);
+
+/**
+ * Runs one control step.
+ * @returns Whether the element should heat
+ */
+bool bang_bang_update(BangBang *c, float target, float temp);
+
+/*
+ * Cascade control from a second thermocouple on the element.
+ *
+ * The outer loop is PI on the cavity temperature and sets a target for the
+ * element. The inner loop is a fixed band around that target on the
+ * element's own temperature. The element answers the relay within
+ * seconds, so the inner loop has little lag to overshoot by, and capping
+ * the element target limits how much heat is stored in the element during
+ * preheat, which is what carries the cavity past its setpoint with a single
+ * loop. The integral learns the element-to-cavity offset needed to hold.
+ */
+typedef struct Cascade {
+    float kp;            // Element degrees per degree of cavity error
+    float ki;            // Element degrees per degree-second of cavity error
+    float element_max;
+    float integral;
+    float element_target;
+    BangBang inner;
+} Cascade;
+
+void cascade_init(Cascade *c, float kp, float ki, float element_max, float element_hysteresis);
+
+/* Starts a new cycle; the integral is kept as the learned holding offset */
+void cascade_reset(Cascade *c);
+
+/**
+ * Runs one control step.
+ * @param dt_s Time since the previous step
+ * @returns Whether the element should heat
+ */
+bool cascade_update(Cascade *c, float target, float cavity, float element, float dt_s);
+
+#endif
@@ -0,0 +1,32 @@
+#include "cycle_log.h"
+#include "control.h"
+
+#include <stdio.h>
+#include <time.h>
+
+int cycle_log_format_csv(const CycleLogRecord *r, char *buf, size_t len) {
+    const CycleSummary *c = &r->summary;
+
+    // ISO 8601 UTC, or empty when the time was never synced
+    char wall[24] = "";
+    if (r->wall_time != CYCLE_LOG_NO_WALL_TIME) {
+        time_t t = (time_t)r->wall_time;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+        strftime(wall, sizeof(wall), "%Y-%m-%dT%H:%M:%SZ", &tm);
+    }
+
+    // Empty unless the cycle ran eco
+    char saved[8] = "";
+    if (r->controller == CONTROL_ECO && r->eco_saved_dwh != CYCLE_LOG_NO_ECO)
+        snprintf(saved, sizeof(saved), "%.1f", r->eco_saved_dwh / 10.0f);
+
+    return snprintf(buf, len, "%lu,%lu,%s,%u,%u,%d,%s,%lu,%ld,%ld,%.2f,%.2f,%.2f,%.2f,%u,%u,%lu,%s",
+                    (unsigned long)r->seq, (unsigned long)r->end_ms, wall, r->mode, r->result, r->target,
+                    control_mode_names[r->controller < CONTROL_MODE_COUNT ? r->controller : CONTROL_FIXED_BAND],
+                    (unsigned long)c->duration_ms,
+                    c->preheat_ms == UINT32_MAX ? -1L : (long)c->preheat_ms,
+                    c->settling_ms == UINT32_MAX ? -1L : (long)c->settling_ms,
+                    c->overshoot, c->rms_error, c->min_temp, c->max_temp,
+                    c->in_band_pct, c->duty_pct, (unsigned long)c->switches, saved);
+}
@@ -0,0 +1,79 @@
+#ifndef CYCLE_LOG_H
+#define CYCLE_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cycle_stats.h"
+
+/*
+ * On-flash cycle log format. One record per finished cycle, appended to a
+ * ring of flash sectors by the firmware and exported verbatim (after a
+ * CycleLogHeader) as trace.bin. Host tools decode dumps with this header,
+ * so any layout change must bump CYCLE_LOG_VERSION.
+ *
+ * Little-endian, naturally aligned, no padding.
+ */
+
+#define CYCLE_LOG_MAGIC   0x474f4c43u // "CLOG"
+#define CYCLE_LOG_VERSION 4
+#define CYCLE_LOG_NO_WALL_TIME 0xFFFFFFFFu // Also what version 1 records hold
+#define CYCLE_LOG_NO_ECO       INT16_MIN   // eco_saved_dwh of a cycle not run by eco
+
+enum {
+    CYCLE_COMPLETED = 0,
+    CYCLE_STOPPED,
+    CYCLE_FAULT,
+};
+
+typedef struct CycleLogRecord {
+    uint32_t magic;
+    uint32_t seq;       // Increments across the life of the unit
+    uint32_t end_ms;    // Milliseconds since boot when the cycle ended
+    uint8_t mode;       // 0 toast, 1 bake, 2 passthru
+    uint8_t result;     // CYCLE_COMPLETED / STOPPED / FAULT
+    int16_t target;     // Celsius
+    CycleSummary summary;
+    uint32_t wall_time; // Unix seconds when the cycle ended, if the host had synced us
+    uint8_t controller; // ControlMode; 0xFF (fixed band) in older records
+    uint8_t reserved;
+    int16_t eco_saved_dwh; // Energy eco saved against the fixed band, 0.1 Wh; only valid for eco
+    uint32_t check;     // cycle_log_checksum over everything before it
+} CycleLogRecord;
+
+_Static_assert(sizeof(CycleSummary) == 36, "CycleSummary layout is part of the log format");
+_Static_assert(sizeof(CycleLogRecord) == 64, "CycleLogRecord must tile flash pages");
+
+typedef struct CycleLogHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint8_t unit_id[8]; // RP2040 flash unique id
+    uint32_t count;     // Records following the header
+    uint8_t reserved[44];
+} CycleLogHeader;
+
+_Static_assert(sizeof(CycleLogHeader) == sizeof(CycleLogRecord), "Header occupies one record slot");
+
+/* FNV-1a */
+static inline uint32_t cycle_log_checksum(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint32_t h = 2166136261u;
+    while (len--) h = (h ^ *p++) * 16777619u;
+    return h;
+}
+
+#define CYCLE_LOG_CSV_HEADER "seq,end_ms,wall_time,mode,result,target_c,controller,duration_ms,preheat_ms,settling_ms,overshoot_c,rms_c,min_c,max_c,in_band_pct,duty_pct,switches,eco_saved_wh"
+
+/**
+ * Formats one record as a CSV row matching CYCLE_LOG_CSV_HEADER, without a
+ * line terminator.
+ * @returns snprintf's result
+ */
+int cycle_log_format_csv(const CycleLogRecord *r, char *buf, size_t len);
+
+static inline int cycle_log_record_valid(const CycleLogRecord *r) {
+    return r->magic == CYCLE_LOG_MAGIC && r->check == cycle_log_checksum(r, offsetof(CycleLogRecord, check));
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include "cycle_stats.h"
+
+#include <math.h>
+
+void cycle_stats_begin(CycleStats *s, float target, float band) {
+    *s = (CycleStats){0};
+    s->target = target;
+    s->band = band;
+    s->min_temp = INFINITY;
+    s->max_temp = -INFINITY;
+}
+
+void cycle_stats_sample(CycleStats *s, uint32_t dt_ms, float temp, bool relay_on) {
+    s->elapsed_ms += dt_ms;
+
+    if (temp < s->min_temp) s->min_temp = temp;
+    if (temp > s->max_temp) s->max_temp = temp;
+
+    if (relay_on) s->relay_on_ms += dt_ms;
+    if (relay_on != s->relay_prev) s->switches++;
+    s->relay_prev = relay_on;
+
+    float err = temp - s->target;
+    if (!s->reached) {
+        if (err < -s->band) return;
+        s->reached = true;
+        s->preheat_ms = s->elapsed_ms;
+    }
+
+    s->hold_ms += dt_ms;
+    s->err_sq_ms += err * err * (float)dt_ms;
+    if (err > s->overshoot) s->overshoot = err;
+
+    bool in_band = fabsf(err) <= s->band;
+    if (in_band) {
+        if (!s->in_band) s->band_entry_ms = s->elapsed_ms - dt_ms;
+        s->in_band_ms += dt_ms;
+    }
+    s->in_band = in_band;
+}
+
+void cycle_stats_summarize(const CycleStats *s, CycleSummary *out) {
+    out->duration_ms = s->elapsed_ms;
+    out->preheat_ms = s->reached ? s->preheat_ms : UINT32_MAX;
+    out->settling_ms = s->in_band ? s->band_entry_ms : UINT32_MAX;
+    out->overshoot = s->overshoot;
+    out->rms_error = s->hold_ms ? sqrtf(s->err_sq_ms / (float)s->hold_ms) : 0;
+    out->min_temp = s->elapsed_ms ? s->min_temp : 0;
+    out->max_temp = s->elapsed_ms ? s->max_temp : 0;
+    out->in_band_pct = s->hold_ms ? (uint16_t)((uint64_t)s->in_band_ms * 100 / s->hold_ms) : 0;
+    out->duty_pct = s->elapsed_ms ? (uint16_t)((uint64_t)s->relay_on_ms * 100 / s->elapsed_ms) : 0;
+    out->switches = s->switches;
+}
@@ -0,0 +1,61 @@
+#ifndef CYCLE_STATS_H
+#define CYCLE_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Streaming per-cycle statistics. Every update is O(1) and no samples are
+ * stored, so the same code runs on the controller and in host benchmarks.
+ * All temperatures are Celsius, all times milliseconds since cycle start.
+ */
+typedef struct CycleStats {
+    float target;
+    float band;          // +/- tolerance used for "in band" and settling
+
+    uint32_t elapsed_ms;
+    uint32_t preheat_ms; // Time to first reach target - band
+    bool reached;
+
+    bool in_band;
+    uint32_t band_entry_ms; // Start of the current stay in the band
+    uint32_t in_band_ms;    // Time in band after preheat
+    uint32_t hold_ms;       // Time after preheat
+
+    float min_temp;
+    float max_temp;
+    float overshoot;        // Highest temperature above target after preheat
+    float err_sq_ms;        // Integral of error^2 after preheat
+
+    bool relay_prev;
+    uint32_t relay_on_ms;
+    uint32_t switches;
+} CycleStats;
+
+/* Summary of a finished (or in-progress) cycle */
+typedef struct CycleSummary {
+    uint32_t duration_ms;
+    uint32_t preheat_ms;   // UINT32_MAX if the target was never reached
+    uint32_t settling_ms;  // UINT32_MAX if not in band at the end
+    float overshoot;
+    float rms_error;
+    float min_temp;
+    float max_temp;
+    uint16_t in_band_pct;  // Of time after preheat
+    uint16_t duty_pct;     // Relay on-time over the whole cycle
+    uint32_t switches;
+} CycleSummary;
+
+void cycle_stats_begin(CycleStats *s, float target, float band);
+
+/**
+ * Accounts one control period.
+ * @param dt_ms Time since the previous call
+ * @param temp Latest temperature, held over the whole period
+ * @param relay_on Relay state during the period
+ */
+void cycle_stats_sample(CycleStats *s, uint32_t dt_ms, float temp, bool relay_on);
+
+void cycle_stats_summarize(const CycleStats *s, CycleSummary *out);
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * Controller benchmark.
+ *
+ * Runs every relay controller through a fixed set of scenarios on several
+ * simulated ovens and prints one table row per run. The decision code is
+ * relay_control.c, exactly as process_cycle runs it; evaluate any change
+ * to it here before flashing.
+ *
+ *   control_bench [--csv] [controller ...]
+ *
+ * Metrics are taken on the true cavity temperature, not the probe. Most
+ * come from the firmware's own statistics engine (cycle_stats.c), run over
+ * the whole scenario against its final reference with SETTLE_BAND_C as the
+ * band, so what the bench scores is what a unit logs:
+ *   preheat    Time until the cavity first reaches the band; "-" if never
+ *   overshoot  Highest cavity temperature above the final reference
+ *   settle     Time from the scenario's last disturbance until the cavity
+ *              stays within the band; "-" if it never does
+ *   RMS        Error after preheat
+ *   in band    Share of the time after preheat spent in the band
+ *   duty       Relay on-time over the whole run
+ *   switches   Relay transitions
+ * and the rest from the bench itself:
+ *   IAE        Integral of |cavity - reference| over the whole run, with the
+ *              reference as it moves
+ *   energy     Element energy over the whole run
+ *   saved      Eco's own estimate of the energy it saved against the fixed band
+ *   load       Load temperature at the end, for scenarios with one
+ *
+ * Every scenario is run as a timed cycle ending with the scenario.
+ *
+ * Besides the firmware's modes there is "pid", a time-proportioned PID that
+ * only exists here, as the textbook baseline the others are measured against.
+ *
+ * The table ends with each controller's mean over every run, so two
+ * controllers compare in one line each, e.g. "control_bench fixed adaptive".
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "cycle_stats.h"
+#include "oven_profile.h"
+#include "plant.h"
+#include "relay_control.h"
+
+#define LOOP_DELAY_MS       20    // As the firmware's main loop
+#define SENSOR_PERIOD_MS    220   // MAX6675 conversion time
+#define SENSOR_RESOLUTION_C 0.25f
+#define AMBIENT_C           25.0f
+#define SETTLE_BAND_C       (2 * TEMP_HYSTERESIS)
+#define F_TO_C(f)           (((f) - 32.0f) * (5.0f / 9.0f))
+
+/* --- Plants --- */
+static const PlantParams plants[] = {
+    // Exactly what the profile's model says, so the MPC has no mismatch
+    {"reference", MODEL_ELEMENT_J_PER_C, MODEL_CAVITY_J_PER_C, MODEL_COUPLING_W_PER_C, MODEL_LOSS_W_PER_C,
+     ELEMENT_WATTS, 8.0f, 2.0f},
+    {"compact",    250.0f,  900.0f, 5.0f, 2.5f, 1200.0f,  5.0f, 2.0f},
+    {"heavy",      700.0f, 3000.0f, 8.0f, 4.0f, 1800.0f, 15.0f, 3.0f},
+    {"slow-probe", MODEL_ELEMENT_J_PER_C, MODEL_CAVITY_J_PER_C, MODEL_COUPLING_W_PER_C, MODEL_LOSS_W_PER_C,
+     ELEMENT_WATTS, 25.0f, 2.0f},
+};
+#define PLANT_COUNT (sizeof(plants) / sizeof(plants[0]))
+
+/* --- Loads --- */
+// A sheet tray warming with the oven
+static const PlantLoad tray = {"tray", 1500, 8, 0, AMBIENT_C};
+// About 600 g of gratin from the fridge
+static const PlantLoad gratin = {"gratin", 2000, 3, 60, 5};
+
+/* --- Scenarios --- */
+#define REF_POINTS_MAX 8
+
+// Reference is linear between points; two points at one time make a step
+typedef struct RefPoint {
+    float t_s;
+    float temp_c;
+} RefPoint;
+
+typedef struct Scenario {
+    const char *name;
+    float duration_s;
+    RefPoint ref[REF_POINTS_MAX];
+    int ref_count;
+    float settle_from_s;  // Negative when settling doesn't apply
+    float door_open_s;    // Door open over [door_open_s, door_close_s)
+    float door_close_s;
+    const PlantLoad *load; // NULL for an empty cavity
+    float load_in_s;       // Put in at this time and left in
+} Scenario;
+
+static const Scenario scenarios[] = {
+    {"cold-350F", 1800, {{0, F_TO_C(350)}}, 1, 0, 0, 0, NULL, 0},
+    {"door-open", 2100, {{0, F_TO_C(350)}}, 1, 1230, 1200, 1230, NULL, 0},
+    {"setpoint-425F", 2400, {{0, F_TO_C(350)}, {1200, F_TO_C(350)}, {1200, F_TO_C(425)}}, 3, 1200, 0, 0, NULL, 0},
+    {"loaded-tray", 1800, {{0, F_TO_C(350)}}, 1, 0, 0, 0, &tray, 0},
+    // Preheat, then the door opens for the food to go in
+    {"cold-food", 2700, {{0, F_TO_C(350)}}, 1, 915, 900, 915, &gratin, 900},
+    // Solder reflow: ramp, soak, ramp to peak and hold
+    {"reflow", 600, {{0, AMBIENT_C}, {240, 150}, {420, 190}, {510, 235}}, 4, -1, 0, 0, NULL, 0},
+};
+#define SCENARIO_COUNT (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/**
+ * Evaluates the reference at t_s.
+ * @param rate Slope of the current segment (C/s)
+ * @param final Where the current segment ends, held after the last point
+ */
+static float scenario_ref(const Scenario *s, float t_s, float *rate, float *final) {
+    int i = 0;
+    while (i + 1 < s->ref_count && s->ref[i + 1].t_s <= t_s) i++;
+    const RefPoint *a = &s->ref[i];
+    if (i + 1 == s->ref_count) {
+        *rate = 0;
+        *final = a->temp_c;
+        return a->temp_c;
+    }
+    const RefPoint *b = &s->ref[i + 1];
+    *rate = (b->temp_c - a->temp_c) / (b->t_s - a->t_s);
+    *final = b->temp_c;
+    return a->temp_c + *rate * (t_s - a->t_s);
+}
+
+/* --- Runs --- */
+typedef struct BenchResult {
+    CycleSummary stats; // From cycle_stats.c
+    float settle_s;   // Negative if not settled or not applicable
+    float iae;        // C*s
+    float energy_wh;
+    float saved_wh;   // NAN unless eco
+    float load;       // NAN without a load
+} BenchResult;
+
+static const RelayControlConfig config = {
+    .hysteresis = TEMP_HYSTERESIS,
+    .element_max = ELEMENT_MAX_TEMP_C,
+    .element_hysteresis = ELEMENT_HYSTERESIS,
+    .cascade_kp = CASCADE_KP,
+    .cascade_ki = CASCADE_KI,
+    .model_element_j_per_c = MODEL_ELEMENT_J_PER_C,
+    .model_cavity_j_per_c = MODEL_CAVITY_J_PER_C,
+    .model_coupling_w_per_c = MODEL_COUPLING_W_PER_C,
+    .model_loss_w_per_c = MODEL_LOSS_W_PER_C,
+    .watts = ELEMENT_WATTS,
+    .switch_penalty = MPC_SWITCH_PENALTY,
+    .eco_energy_penalty = ECO_ENERGY_PENALTY,
+    .ambient = AMBIENT_C,
+};
+
+/* --- PID baseline --- */
+// Time-proportioned: the output is recomputed once per window and the relay
+// is on for that share of it. The gains scored best on these scenarios.
+#define PID_WINDOW_MS 2000
+#define PID_KP        0.05f    // Duty per C of error
+#define PID_KI        0.0001f  // Duty per C*s
+#define PID_KD        2.0f     // Duty per C/s, on the measurement
+
+typedef struct Pid {
+    float integral;     // C*s
+    float prev_temp;
+    float duty;         // This window's share, 0..1
+    uint32_t window_ms; // Start of the current window
+    bool started;
+} Pid;
+
+/**
+ * Steps the PID on one loop pass.
+ * @returns Whether the relay should be on
+ */
+static bool pid_update(Pid *c, uint32_t now_ms, float ref, float temp) {
+    if (!c->started || now_ms - c->window_ms >= PID_WINDOW_MS) {
+        const float window_s = PID_WINDOW_MS / 1000.0f;
+        float error = ref - temp;
+        float slope = c->started ? (temp - c->prev_temp) / window_s : 0;
+        float integral = c->integral + error * window_s;
+        float u = PID_KP * error + PID_KI * integral - PID_KD * slope;
+        // Conditional integration: hold the integral while it would only
+        // push a saturated output further
+        if ((u < 1 || error < 0) && (u > 0 || error > 0)) c->integral = integral;
+        c->duty = fminf(fmaxf(u, 0), 1);
+        c->prev_temp = temp;
+        c->window_ms = c->started ? c->window_ms + PID_WINDOW_MS : now_ms;
+        c->started = true;
+    }
+    return now_ms - c->window_ms < c->duty * PID_WINDOW_MS;
+}
+
+/* --- Controllers --- */
+// The firmware's modes by ControlMode, then the bench's own baseline
+#define BENCH_PID        CONTROL_MODE_COUNT
+#define CONTROLLER_COUNT (CONTROL_MODE_COUNT + 1)
+
+static const char *controller_name(int c) {
+    return c == BENCH_PID ? "pid" : control_mode_names[c];
+}
+
+static float sensor_read(float temp) {
+    return floorf(temp / SENSOR_RESOLUTION_C) * SENSOR_RESOLUTION_C;
+}
+
+static void bench_run(const Scenario *s, const PlantParams *p, int controller, BenchResult *out) {
+    Plant pl;
+    plant_init(&pl, p, AMBIENT_C);
+
+    float cavity = sensor_read(pl.probe);
+    float element = sensor_read(pl.element_probe);
+    bool pid = controller == BENCH_PID;
+    RelayControl rc;
+    relay_control_init(&rc, pid ? CONTROL_FIXED_BAND : (ControlMode)controller, &config, cavity);
+    Pid pc = {0};
+
+    const float dt_s = LOOP_DELAY_MS / 1000.0f;
+    uint32_t steps = (uint32_t)(s->duration_s * 1000 / LOOP_DELAY_MS);
+    uint32_t next_sample_ms = 0;
+    bool relay = false;
+    *out = (BenchResult){0};
+
+    float rate, final;
+    scenario_ref(s, s->duration_s, &rate, &final);
+    CycleStats stats;
+    cycle_stats_begin(&stats, final, SETTLE_BAND_C);
+
+    for (uint32_t i = 0; i < steps; i++) {
+        uint32_t now_ms = i * LOOP_DELAY_MS;
+        float t_s = now_ms / 1000.0f;
+        pl.door_open = t_s >= s->door_open_s && t_s < s->door_close_s;
+        if (s->load && i == (uint32_t)(s->load_in_s * 1000 / LOOP_DELAY_MS)) plant_add_load(&pl, s->load);
+
+        if (now_ms >= next_sample_ms) {
+            cavity = sensor_read(pl.probe);
+            element = sensor_read(pl.element_probe);
+            next_sample_ms += SENSOR_PERIOD_MS;
+        }
+
+        float rate, final;
+        float ref = scenario_ref(s, t_s, &rate, &final);
+        uint32_t remaining_ms = (uint32_t)(s->duration_s * 1000) - now_ms;
+        if (pid) {
+            relay = pid_update(&pc, now_ms, ref, cavity);
+        } else {
+            relay = relay_control_update(&rc, now_ms, ref, rate, final, remaining_ms, cavity, element, dt_s);
+            relay_control_applied(&rc, relay);
+        }
+
+        // As the firmware samples once per pass, but on the cavity itself
+        cycle_stats_sample(&stats, LOOP_DELAY_MS, pl.cavity, relay);
+        out->iae += fabsf(pl.cavity - ref) * dt_s;
+
+        plant_step(&pl, relay, dt_s);
+    }
+
+    cycle_stats_summarize(&stats, &out->stats);
+    out->energy_wh = (float)(pl.energy_j / 3600.0);
+    out->saved_wh = relay_control_energy_saved_wh(&rc);
+    out->load = s->load ? pl.load : NAN;
+    // The engine's settling time counts from the cycle start; a stay in the
+    // band that began before the disturbance means it never left
+    out->settle_s = -1;
+    if (s->settle_from_s >= 0 && out->stats.settling_ms != UINT32_MAX) {
+        out->settle_s = fmaxf(0, out->stats.settling_ms / 1000.0f - s->settle_from_s);
+    }
+}
+
+/* --- Report --- */
+// Per-controller sums for the summary
+typedef struct BenchTotals {
+    uint32_t runs;
+    uint32_t settle_runs; // Runs of scenarios where settling applies
+    uint32_t settled;
+    double overshoot;
+    double rms;
+    double in_band;
+    double switches;
+    double iae;
+} BenchTotals;
+
+static void totals_add(BenchTotals *t, const Scenario *s, const BenchResult *r) {
+    t->runs++;
+    t->settle_runs += s->settle_from_s >= 0;
+    t->settled += r->settle_s >= 0;
+    t->overshoot += r->stats.overshoot;
+    t->rms += r->stats.rms_error;
+    t->in_band += r->stats.in_band_pct;
+    t->switches += r->stats.switches;
+    t->iae += r->iae / 60;
+}
+
+int main(int argc, char **argv) {
+    bool csv = false;
+    bool selected[CONTROLLER_COUNT] = {0};
+    bool any_selected = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) {
+            csv = true;
+            continue;
+        }
+        int m = 0;
+        while (m < CONTROLLER_COUNT && strcmp(argv[i], controller_name(m)) != 0) m++;
+        if (m == CONTROLLER_COUNT) {
+            fprintf(stderr, "usage: %s [--csv] [controller ...]\n", argv[0]);
+            return 2;
+        }
+        selected[m] = any_selected = true;
+    }
+
+    if (csv) {
+        printf("scenario,plant,controller,preheat_s,overshoot_c,settle_s,rms_c,in_band_pct,duty_pct,switches,"
+               "iae_c_min,energy_wh,saved_wh,load_c\n");
+    } else {
+        printf("Profile %s, settling band +/-%.1fC\n\n", OVEN_NAME, SETTLE_BAND_C);
+        printf("%-14s %-11s %-9s %7s %9s %7s %6s %7s %5s %8s %8s %7s %6s %5s\n", "scenario", "plant", "ctrl",
+               "preheat", "overshoot", "settle", "RMS", "in band", "duty", "switches", "IAE", "energy", "saved", "load");
+        printf("%-14s %-11s %-9s %7s %9s %7s %6s %7s %5s %8s %8s %7s %6s %5s\n", "", "", "", "s", "C", "s", "C", "%",
+               "%", "", "C*min", "Wh", "Wh", "C");
+    }
+
+    BenchTotals totals[CONTROLLER_COUNT] = {0};
+    for (size_t si = 0; si < SCENARIO_COUNT; si++) {
+        for (size_t pi = 0; pi < PLANT_COUNT; pi++) {
+            for (int m = 0; m < CONTROLLER_COUNT; m++) {
+                if (any_selected && !selected[m]) continue;
+                BenchResult r;
+                bench_run(&scenarios[si], &plants[pi], m, &r);
+                totals_add(&totals[m], &scenarios[si], &r);
+
+                const CycleSummary *st = &r.stats;
+                bool reached = st->preheat_ms != UINT32_MAX;
+                char preheat[16] = "-", settle[16] = "-", saved[16] = "-", load[16] = "-";
+                if (reached) snprintf(preheat, sizeof(preheat), "%.0f", st->preheat_ms / 1000.0);
+                if (r.settle_s >= 0) snprintf(settle, sizeof(settle), "%.0f", r.settle_s);
+                if (!isnan(r.saved_wh)) snprintf(saved, sizeof(saved), "%.1f", r.saved_wh);
+                if (!isnan(r.load)) snprintf(load, sizeof(load), "%.1f", r.load);
+                printf(csv ? "%s,%s,%s,%s,%.2f,%s,%.2f,%u,%u,%lu,%.1f,%.1f,%s,%s\n"
+                           : "%-14s %-11s %-9s %7s %9.2f %7s %6.2f %7u %5u %8lu %8.1f %7.1f %6s %5s\n",
+                       scenarios[si].name, plants[pi].name, controller_name(m), csv && !reached ? "" : preheat,
+                       st->overshoot, csv && r.settle_s < 0 ? "" : settle, st->rms_error, st->in_band_pct,
+                       st->duty_pct, (unsigned long)st->switches, r.iae / 60, r.energy_wh,
+                       csv && isnan(r.saved_wh) ? "" : saved, csv && isnan(r.load) ? "" : load);
+            }
+        }
+        if (!csv) printf("\n");
+    }
+
+    if (!csv) {
+        printf("Mean over %zu scenarios on %zu plants\n", SCENARIO_COUNT, PLANT_COUNT);
+        printf("%-9s %9s %6s %7s %8s %8s %7s\n", "ctrl", "overshoot", "RMS", "in band", "switches", "IAE", "settled");
+        for (int m = 0; m < CONTROLLER_COUNT; m++) {
+            const BenchTotals *t = &totals[m];
+            if (t->runs == 0) continue;
+            char settled[24];
+            snprintf(settled, sizeof(settled), "%lu/%lu", (unsigned long)t->settled, (unsigned long)t->settle_runs);
+            printf("%-9s %9.2f %6.2f %7.0f %8.1f %8.1f %7s\n", controller_name(m), t->overshoot / t->runs,
+                   t->rms / t->runs, t->in_band / t->runs, t->switches / t->runs, t->iae / t->runs, settled);
+        }
+    }
+    return 0;
+}
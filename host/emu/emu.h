@@ -0,0 +1,41 @@
+#ifndef EMU_H
+#define EMU_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Emulator internals. sdk.c implements the Pico SDK calls the firmware
+ * makes; emulator.c owns the virtual clock and the devices on the pins.
+ */
+
+extern uint64_t emu_now_ns;
+
+/* --- emulator.c --- */
+/* Runs the world for ns, firing whatever falls due on the way */
+void emu_advance_ns(uint64_t ns);
+/* An output pin changed level */
+void emu_gpio_changed(unsigned int pin, bool level);
+/* Level driven onto an input pin from outside */
+bool emu_gpio_input(unsigned int pin);
+/* @returns Bytes transferred, or PICO_ERROR_GENERIC when the address isn't acknowledged */
+int emu_i2c_write(unsigned int baud, uint8_t addr, const uint8_t *src, size_t len);
+int emu_i2c_read(unsigned int baud, uint8_t addr, uint8_t *dst, size_t len);
+/* Clocks len bytes in from whichever device has its chip select low */
+void emu_spi_read(unsigned int baud, uint8_t *dst, size_t len);
+/* @returns The next USB console character, -1 when none is waiting */
+int emu_console_getc(void);
+
+/* --- sdk.c --- */
+extern bool sdk_irq_enabled;
+void sdk_init(void);
+bool sdk_gpio_out_level(unsigned int pin);
+/* @returns When the next alarm or timer fires, UINT64_MAX if none can */
+uint64_t sdk_next_alarm_us(void);
+/* Fires the alarms and timers due at the current time */
+void sdk_run_alarms(void);
+/* @returns When the watchdog expires, UINT64_MAX while it isn't enabled */
+uint64_t sdk_watchdog_deadline_us(void);
+
+#endif
@@ -0,0 +1,702 @@
+/*
+ * Host emulator.
+ *
+ * Runs the unmodified firmware (Smart-Toaster.c, with main renamed) on the
+ * host against sdk.c and a virtual clock. Whatever the firmware drives
+ * meets a model: the relay heats a simulated oven (host/plant.c), each
+ * MAX6675 converts its probe, and the PCF8574 backpack feeds an HD44780
+ * whose screen is printed at the end, along with any nibbles it dropped
+ * for arriving before the previous instruction finished. Buttons and USB console lines come
+ * from a script.
+ *
+ *   emulator [--time S] [--vcd FILE] [--from S] [--i2c-bits] [script]
+ *
+ * --vcd writes the buttons, relay, buzzer, SPI frames, I2C bytes and the
+ * expander's LCD pins against the virtual clock, for GTKWave. --from
+ * starts the trace S seconds in, and --i2c-bits adds SCL and SDA bit by
+ * bit, which makes the file several times larger.
+ *
+ * Script lines are "<seconds> <action> [args]", "#" starting a comment:
+ *   press MODE|UP|DOWN|START [ms]   Holds a button, 100 ms by default
+ *   type <line>                     Sends a line to the USB console
+ *   fault <kind> [ms]               Breaks the cavity thermocouple: open,
+ *                                   stuck, rate (a 100 C jump), ones or
+ *                                   zeros (MISO floating or shorted), or
+ *                                   none to repair it
+ * A fault's ms is the longest the relay may stay on after it; the
+ * emulator exits with status 1 if it does, or was already off. How long
+ * the relay took is printed at the end either way.
+ * Without a script the emulator starts a bake ten steps above the default
+ * temperature.
+ *
+ * The clock only moves while the firmware waits: sleeps, bus transfers and
+ * flash operations. Code between them takes no time.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/stdlib.h"
+
+#include "emu.h"
+#include "oven_profile.h"
+#include "plant.h"
+#include "vcd.h"
+
+#define EMU_BOOT_US            1000    // Clock at main(), after the SDK's runtime init
+#define EMU_PLANT_STEP_US      10000
+#define EMU_AMBIENT_C          25.0f
+#define EMU_TIME_DEFAULT_S     60
+#define EMU_PRESS_MS           100
+#define EMU_EXPANDER_ADDR      0x27
+#define EMU_EXPANDER_MAX_HZ    400000  // Above this the PCF8574 misreads every byte
+#define EMU_MAX6675_CONVERT_US 220000
+#define EMU_CONSOLE_MAX        256
+#define EMU_FAULT_RATE_STEP_C  100.0f
+
+int firmware_main(void);
+
+uint64_t emu_now_ns;
+static uint64_t stop_ns;
+
+/* --- Oven --- */
+static const PlantParams oven = {"reference", MODEL_ELEMENT_J_PER_C, MODEL_CAVITY_J_PER_C, MODEL_COUPLING_W_PER_C,
+                                 MODEL_LOSS_W_PER_C, ELEMENT_WATTS, 8.0f, 2.0f};
+static Plant plant;
+static uint64_t plant_next_ns;
+
+/* --- Buttons --- */
+static const struct {
+    const char *name;
+    unsigned int pin;
+} buttons[] = {
+    {"MODE", PIN_BTN_MODE},
+    {"UP", PIN_BTN_UP},
+    {"DOWN", PIN_BTN_DOWN},
+    {"START", PIN_BTN_START},
+};
+#define BUTTON_COUNT (sizeof(buttons) / sizeof(buttons[0]))
+
+static bool pressed[BUTTON_COUNT];
+
+/* --- Trace --- */
+static Vcd vcd;
+static bool i2c_bits = false;
+static int pin_signal[NUM_BANK0_GPIOS];
+static int sig_sck, sig_miso, sig_frame;
+static int sig_i2c_busy, sig_i2c_addr, sig_i2c_byte, sig_scl, sig_sda;
+static int sig_rs, sig_rw, sig_e, sig_bl, sig_d;
+static int sig_cavity, sig_element;
+
+static void trace_pin(unsigned int pin, const char *name) {
+    pin_signal[pin] = vcd_signal(&vcd, name, 1);
+}
+
+static void trace_open(const char *path, uint64_t from_ns) {
+    for (int i = 0; i < NUM_BANK0_GPIOS; i++) pin_signal[i] = -1;
+    sig_scl = sig_sda = -1;
+    if (!path) return;
+    if (!vcd_open(&vcd, path, from_ns)) {
+        perror(path);
+        exit(2);
+    }
+
+    vcd_scope(&vcd, "gpio");
+    trace_pin(PIN_RELAY, "relay");
+    trace_pin(PIN_BUZZER, "buzzer");
+    trace_pin(PIN_BTN_MODE, "btn_mode");
+    trace_pin(PIN_BTN_UP, "btn_up");
+    trace_pin(PIN_BTN_DOWN, "btn_down");
+    trace_pin(PIN_BTN_START, "btn_start");
+#if POWER_BUS
+    trace_pin(PIN_BUS_DE, "bus_de");
+#endif
+
+    vcd_scope(&vcd, "spi");
+    trace_pin(PIN_CS, "cs");
+#if ELEMENT_SENSOR
+    trace_pin(PIN_CS_ELEMENT, "cs_element");
+#endif
+    sig_sck = vcd_signal(&vcd, "sck", 1);
+    sig_miso = vcd_signal(&vcd, "miso", 1);
+    sig_frame = vcd_signal(&vcd, "frame", 16);
+
+    vcd_scope(&vcd, "i2c");
+    sig_i2c_busy = vcd_signal(&vcd, "busy", 1);
+    sig_i2c_addr = vcd_signal(&vcd, "addr", 7);
+    sig_i2c_byte = vcd_signal(&vcd, "byte", 8);
+    if (i2c_bits) {
+        sig_scl = vcd_signal(&vcd, "scl", 1);
+        sig_sda = vcd_signal(&vcd, "sda", 1);
+    }
+
+    // The expander's port as the LCD sees it
+    vcd_scope(&vcd, "lcd");
+    sig_rs = vcd_signal(&vcd, "rs", 1);
+    sig_rw = vcd_signal(&vcd, "rw", 1);
+    sig_e = vcd_signal(&vcd, "e", 1);
+    sig_bl = vcd_signal(&vcd, "backlight", 1);
+    sig_d = vcd_signal(&vcd, "d7_d4", 4);
+
+    vcd_scope(&vcd, "oven");
+    sig_cavity = vcd_signal(&vcd, "cavity_c", 0);
+    sig_element = vcd_signal(&vcd, "element_c", 0);
+    vcd_header_done(&vcd);
+
+    // Levels at boot: buttons pulled up, outputs not yet driven
+    for (int i = 0; i < NUM_BANK0_GPIOS; i++) vcd_set(&vcd, pin_signal[i], emu_now_ns, 0);
+    for (size_t b = 0; b < BUTTON_COUNT; b++) vcd_set(&vcd, pin_signal[buttons[b].pin], emu_now_ns, 1);
+    vcd_set(&vcd, sig_sck, emu_now_ns, 0);
+    vcd_set(&vcd, sig_i2c_busy, emu_now_ns, 0);
+    vcd_set(&vcd, sig_scl, emu_now_ns, 1);
+    vcd_set(&vcd, sig_sda, emu_now_ns, 1);
+}
+
+/* --- Script --- */
+typedef enum { EVENT_PRESS, EVENT_RELEASE, EVENT_TYPE, EVENT_FAULT } EventKind;
+
+typedef enum { FAULT_NONE, FAULT_OPEN, FAULT_STUCK, FAULT_RATE, FAULT_ONES, FAULT_ZEROS, FAULT_COUNT } FaultKind;
+static const char *const fault_names[FAULT_COUNT] = {"none", "open", "stuck", "rate", "ones", "zeros"};
+static void fault_inject(FaultKind kind, uint32_t limit_ms);
+
+typedef struct Event {
+    uint64_t at_ns;
+    int seq;         // Keeps events at one time in script order
+    EventKind kind;
+    int button;
+    FaultKind fault;
+    uint32_t limit_ms; // 0 when the fault's detection isn't checked
+    char text[64];
+} Event;
+
+// Bake, ten steps up from the default temperature, start
+static const char default_script[] =
+    "1.0 press MODE\n"
+    "1.5 press UP\n" "1.8 press UP\n" "2.1 press UP\n" "2.4 press UP\n" "2.7 press UP\n"
+    "3.0 press UP\n" "3.3 press UP\n" "3.6 press UP\n" "3.9 press UP\n" "4.2 press UP\n"
+    "5.0 press START\n";
+
+static Event *events;
+static size_t event_count, event_next;
+static char console[EMU_CONSOLE_MAX];
+static size_t console_head, console_len;
+
+static Event *event_add(uint64_t at_ns, EventKind kind) {
+    events = realloc(events, (event_count + 1) * sizeof(Event));
+    Event *e = &events[event_count];
+    *e = (Event){.at_ns = at_ns, .seq = (int)event_count, .kind = kind};
+    event_count++;
+    return e;
+}
+
+static int event_compare(const void *a, const void *b) {
+    const Event *x = a, *y = b;
+    if (x->at_ns != y->at_ns) return x->at_ns < y->at_ns ? -1 : 1;
+    return x->seq - y->seq;
+}
+
+static void script_parse(const char *text, const char *source) {
+    int line_no = 0;
+    while (*text) {
+        const char *end = strchr(text, '\n');
+        size_t len = end ? (size_t)(end - text) : strlen(text);
+        char line[256];
+        snprintf(line, sizeof(line), "%.*s", (int)MIN(len, sizeof(line) - 1), text);
+        text += end ? len + 1 : len;
+        line_no++;
+
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        double at_s;
+        char action[16];
+        int used;
+        if (sscanf(line, " %lf %15s %n", &at_s, action, &used) < 2) {
+            if (strspn(line, " \t\r") != strlen(line)) fprintf(stderr, "%s:%d: expected <seconds> <action>\n", source, line_no);
+            continue;
+        }
+        uint64_t at_ns = (uint64_t)(at_s * 1e9);
+        char *args = line + used;
+        args[strcspn(args, "\r")] = '\0';
+
+        if (strcmp(action, "press") == 0) {
+            char name[16];
+            int ms = EMU_PRESS_MS;
+            if (sscanf(args, "%15s %d", name, &ms) < 1) name[0] = '\0';
+            size_t b = 0;
+            while (b < BUTTON_COUNT && strcasecmp(name, buttons[b].name) != 0) b++;
+            if (b == BUTTON_COUNT) {
+                fprintf(stderr, "%s:%d: unknown button '%s'\n", source, line_no, name);
+                exit(2);
+            }
+            event_add(at_ns, EVENT_PRESS)->button = (int)b;
+            event_add(at_ns + (uint64_t)ms * 1000000, EVENT_RELEASE)->button = (int)b;
+        } else if (strcmp(action, "fault") == 0) {
+            char name[16];
+            unsigned limit_ms = 0;
+            if (sscanf(args, "%15s %u", name, &limit_ms) < 1) name[0] = '\0';
+            int f = 0;
+            while (f < FAULT_COUNT && strcasecmp(name, fault_names[f]) != 0) f++;
+            if (f == FAULT_COUNT) {
+                fprintf(stderr, "%s:%d: unknown fault '%s'\n", source, line_no, name);
+                exit(2);
+            }
+            Event *e = event_add(at_ns, EVENT_FAULT);
+            e->fault = (FaultKind)f;
+            e->limit_ms = limit_ms;
+        } else if (strcmp(action, "type") == 0) {
+            snprintf(event_add(at_ns, EVENT_TYPE)->text, sizeof(events->text), "%s\n", args);
+        } else {
+            fprintf(stderr, "%s:%d: unknown action '%s'\n", source, line_no, action);
+            exit(2);
+        }
+    }
+    qsort(events, event_count, sizeof(Event), event_compare);
+}
+
+static void script_load(const char *path) {
+    if (!path) {
+        script_parse(default_script, "default script");
+        return;
+    }
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        exit(2);
+    }
+    char *text = NULL;
+    size_t len = 0, cap = 0;
+    int c;
+    while ((c = fgetc(f)) != EOF) {
+        if (len + 2 > cap) text = realloc(text, cap = cap ? cap * 2 : 1024);
+        text[len++] = (char)c;
+    }
+    fclose(f);
+    if (!text) return;
+    text[len] = '\0';
+    script_parse(text, path);
+    free(text);
+}
+
+static void event_run(const Event *e) {
+    switch (e->kind) {
+        case EVENT_PRESS:
+        case EVENT_RELEASE:
+            pressed[e->button] = e->kind == EVENT_PRESS;
+            vcd_set(&vcd, pin_signal[buttons[e->button].pin], emu_now_ns, !pressed[e->button]);
+            break;
+        case EVENT_FAULT:
+            fault_inject(e->fault, e->limit_ms);
+            break;
+        case EVENT_TYPE:
+            for (const char *s = e->text; *s && console_len < EMU_CONSOLE_MAX; s++) {
+                console[(console_head + console_len++) % EMU_CONSOLE_MAX] = *s;
+            }
+            break;
+    }
+}
+
+int emu_console_getc(void) {
+    if (!console_len) return -1;
+    char c = console[console_head];
+    console_head = (console_head + 1) % EMU_CONSOLE_MAX;
+    console_len--;
+    return (unsigned char)c;
+}
+
+bool emu_gpio_input(unsigned int pin) {
+    for (size_t b = 0; b < BUTTON_COUNT; b++) {
+        if (buttons[b].pin == pin) return !pressed[b]; // Active low with pull-ups
+    }
+    return true;
+}
+
+/* --- Statistics --- */
+static uint32_t relay_switches, buzzer_beeps, spi_frames, i2c_transfers, i2c_bytes;
+static uint64_t relay_on_ns, i2c_busy_ns, spi_busy_ns;
+
+/* --- MAX6675 --- */
+typedef struct Max6675 {
+    unsigned int cs;
+    const float *probe;
+    uint16_t frame;       // Last conversion result
+    uint64_t ready_ns;    // When the conversion started at CS rising completes
+    FaultKind fault;
+} Max6675;
+
+static Max6675 sensors[] = {
+    {PIN_CS, &plant.probe, 0, 0, FAULT_NONE},
+#if ELEMENT_SENSOR
+    {PIN_CS_ELEMENT, &plant.element_probe, 0, 0, FAULT_NONE},
+#endif
+};
+#define SENSOR_COUNT (sizeof(sensors) / sizeof(sensors[0]))
+
+static Max6675 *spi_selected = NULL;
+static uint16_t spi_shift;
+
+static uint16_t max6675_convert(const Max6675 *s) {
+    float probe = *s->probe + (s->fault == FAULT_RATE ? EMU_FAULT_RATE_STEP_C : 0);
+    float quarters = floorf(probe * 4);
+    uint16_t frame = (uint16_t)((uint16_t)fminf(fmaxf(quarters, 0), 4095) << 3);
+    // D2 flags an open thermocouple input
+    return s->fault == FAULT_OPEN ? frame | 0x0004 : frame;
+}
+
+/* --- Fault injection --- */
+static struct {
+    FaultKind kind;        // Last fault injected, FAULT_NONE if none yet
+    uint64_t at_ns;
+    uint32_t limit_ms;
+    bool relay_was_on;
+    bool waiting;          // For the relay to drop
+    uint64_t latency_ns;   // Injection to the relay dropping
+} fault;
+
+static void fault_inject(FaultKind kind, uint32_t limit_ms) {
+    sensors[0].fault = kind;
+    if (kind == FAULT_NONE) return;
+    bool relay = sdk_gpio_out_level(PIN_RELAY);
+    fault.kind = kind;
+    fault.at_ns = emu_now_ns;
+    fault.limit_ms = limit_ms;
+    fault.relay_was_on = relay;
+    fault.waiting = relay;
+}
+
+static void fault_relay_off(void) {
+    if (!fault.waiting) return;
+    fault.waiting = false;
+    fault.latency_ns = emu_now_ns - fault.at_ns;
+}
+
+/* Prints how the last injected fault was handled; @returns false if it broke its limit */
+static bool fault_report(void) {
+    if (fault.kind == FAULT_NONE) return true;
+    fprintf(stderr, "EMU fault %s at %.3f s, ", fault_names[fault.kind], fault.at_ns / 1e9);
+    bool ok;
+    if (!fault.relay_was_on) {
+        fprintf(stderr, "relay already off");
+        ok = false;
+    } else if (fault.waiting) {
+        fprintf(stderr, "relay still on after %.1f ms", (emu_now_ns - fault.at_ns) / 1e6);
+        ok = false;
+    } else {
+        fprintf(stderr, "relay off after %.1f ms", fault.latency_ns / 1e6);
+        ok = fault.latency_ns <= (uint64_t)fault.limit_ms * 1000000;
+    }
+    if (fault.limit_ms) {
+        fprintf(stderr, ", limit %lu ms: %s", (unsigned long)fault.limit_ms, ok ? "ok" : "FAIL");
+    } else {
+        ok = true;
+    }
+    fprintf(stderr, "\n");
+    return ok;
+}
+
+static void max6675_select(Max6675 *s, bool cs) {
+    if (cs) {
+        // Deselecting starts a conversion
+        s->ready_ns = emu_now_ns + (uint64_t)EMU_MAX6675_CONVERT_US * 1000;
+        if (spi_selected == s) spi_selected = NULL;
+        return;
+    }
+    // Reading before a conversion completes returns the previous result
+    if (emu_now_ns >= s->ready_ns && s->fault != FAULT_STUCK) s->frame = max6675_convert(s);
+    spi_selected = s;
+    spi_shift = s->fault == FAULT_ONES ? 0xFFFF : s->fault == FAULT_ZEROS ? 0x0000 : s->frame;
+    vcd_set(&vcd, sig_miso, emu_now_ns, spi_shift >> 15);
+}
+
+void emu_spi_read(unsigned int baud, uint8_t *dst, size_t len) {
+    uint64_t half_ns = 500000000u / baud;
+    uint64_t start_ns = emu_now_ns;
+    uint16_t frame = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            // Mode 0: sampled on the rising edge, shifted on the falling one
+            bool miso = spi_selected && (spi_shift & 0x8000);
+            vcd_set(&vcd, sig_miso, emu_now_ns, miso);
+            emu_advance_ns(half_ns);
+            vcd_set(&vcd, sig_sck, emu_now_ns, 1);
+            byte = (uint8_t)(byte << 1 | miso);
+            emu_advance_ns(half_ns);
+            vcd_set(&vcd, sig_sck, emu_now_ns, 0);
+            spi_shift <<= 1;
+        }
+        dst[i] = byte;
+        frame = (uint16_t)(frame << 8 | byte);
+    }
+    vcd_set(&vcd, sig_frame, emu_now_ns, frame);
+    spi_frames++;
+    spi_busy_ns += emu_now_ns - start_ns;
+}
+
+/* --- HD44780 behind a PCF8574 --- */
+#define LCD_RS 0x01
+#define LCD_RW 0x02
+#define LCD_E  0x04
+#define LCD_BL 0x08
+#define LCD_COLUMNS 40 // DDRAM per line; 16 are visible
+#define LCD_EXEC_NS  37000   // Most instructions and data writes
+#define LCD_CLEAR_NS 1520000 // Clear and home
+
+static uint8_t expander_port = 0xFF; // Quasi-bidirectional pins power up high
+static struct {
+    bool four_bit;   // Powers up in 8-bit mode, of which only D7-D4 are wired
+    bool have_high;  // First nibble of a 4-bit transfer is latched
+    uint8_t high;
+    uint8_t addr;
+    bool display_on;
+    uint64_t busy_until_ns;
+    uint32_t busy_writes; // Nibbles latched while busy, which are lost
+    char ddram[2][LCD_COLUMNS];
+} lcd = {.ddram = {"                                        ", "                                        "}};
+
+static void lcd_execute(bool rs, uint8_t value) {
+    lcd.busy_until_ns = emu_now_ns + (!rs && value >= 0x01 && value <= 0x03 ? LCD_CLEAR_NS : LCD_EXEC_NS);
+    if (rs) {
+        int line = (lcd.addr & 0x40) != 0;
+        int column = lcd.addr & 0x3F;
+        if (column < LCD_COLUMNS) lcd.ddram[line][column] = (char)value;
+        lcd.addr = (uint8_t)((lcd.addr & 0x40) | (column + 1) % LCD_COLUMNS);
+    } else if (value & 0x80) {
+        lcd.addr = value & 0x7F;
+    } else if (value & 0x40) {
+        // CGRAM address; custom characters aren't modelled
+    } else if (value & 0x20) {
+        bool four_bit = !(value & 0x10);
+        if (four_bit != lcd.four_bit) lcd.have_high = false;
+        lcd.four_bit = four_bit;
+    } else if (value & 0x08) {
+        lcd.display_on = value & 0x04;
+    } else if (value & 0x02) {
+        lcd.addr = 0;
+    } else if (value & 0x01) {
+        memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+        lcd.addr = 0;
+    }
+}
+
+static void expander_write(uint8_t value) {
+    uint8_t was = expander_port;
+    expander_port = value;
+    vcd_set(&vcd, sig_rs, emu_now_ns, value & LCD_RS);
+    vcd_set(&vcd, sig_rw, emu_now_ns, (value & LCD_RW) != 0);
+    vcd_set(&vcd, sig_e, emu_now_ns, (value & LCD_E) != 0);
+    vcd_set(&vcd, sig_bl, emu_now_ns, (value & LCD_BL) != 0);
+    vcd_set(&vcd, sig_d, emu_now_ns, value >> 4);
+
+    // The LCD latches D7-D4 on the falling edge of E
+    if (!(was & LCD_E) || (value & LCD_E) || (value & LCD_RW)) return;
+    if (emu_now_ns < lcd.busy_until_ns) {
+        lcd.busy_writes++;
+        return;
+    }
+    uint8_t nibble = value >> 4;
+    if (!lcd.four_bit) {
+        lcd_execute(value & LCD_RS, (uint8_t)(nibble << 4));
+    } else if (!lcd.have_high) {
+        lcd.high = nibble;
+        lcd.have_high = true;
+    } else {
+        lcd.have_high = false;
+        lcd_execute(value & LCD_RS, (uint8_t)(lcd.high << 4 | nibble));
+    }
+}
+
+/* --- I2C --- */
+static uint64_t i2c_bit_ns;
+
+// One bit: SDA changes while SCL is low and is held through the high phase
+static void i2c_bit(bool sda) {
+    vcd_set(&vcd, sig_sda, emu_now_ns, sda);
+    emu_advance_ns(i2c_bit_ns / 4);
+    vcd_set(&vcd, sig_scl, emu_now_ns, 1);
+    emu_advance_ns(i2c_bit_ns / 2);
+    vcd_set(&vcd, sig_scl, emu_now_ns, 0);
+    emu_advance_ns(i2c_bit_ns / 4);
+}
+
+// Eight bits MSB first and the acknowledge
+static void i2c_byte(uint8_t value, bool ack) {
+    if (!i2c_bits) {
+        emu_advance_ns(9 * i2c_bit_ns);
+        return;
+    }
+    for (int bit = 7; bit >= 0; bit--) i2c_bit((value >> bit) & 1);
+    i2c_bit(!ack);
+}
+
+static void i2c_start(unsigned int baud, uint8_t addr, bool read) {
+    i2c_bit_ns = 1000000000u / baud;
+    i2c_transfers++;
+    vcd_set(&vcd, sig_i2c_busy, emu_now_ns, 1);
+    vcd_set(&vcd, sig_i2c_addr, emu_now_ns, addr);
+    // SDA falls while SCL is high
+    vcd_set(&vcd, sig_sda, emu_now_ns, 0);
+    emu_advance_ns(i2c_bit_ns / 2);
+    vcd_set(&vcd, sig_scl, emu_now_ns, 0);
+    i2c_byte((uint8_t)(addr << 1 | read), addr == EMU_EXPANDER_ADDR);
+}
+
+static void i2c_stop(uint64_t start_ns) {
+    // SDA rises while SCL is high
+    vcd_set(&vcd, sig_sda, emu_now_ns, 0);
+    emu_advance_ns(i2c_bit_ns / 4);
+    vcd_set(&vcd, sig_scl, emu_now_ns, 1);
+    emu_advance_ns(i2c_bit_ns / 4);
+    vcd_set(&vcd, sig_sda, emu_now_ns, 1);
+    vcd_set(&vcd, sig_i2c_busy, emu_now_ns, 0);
+    i2c_busy_ns += emu_now_ns - start_ns;
+    // Bus free time before the next start
+    emu_advance_ns(i2c_bit_ns / 2);
+}
+
+int emu_i2c_write(unsigned int baud, uint8_t addr, const uint8_t *src, size_t len) {
+    uint64_t start_ns = emu_now_ns;
+    i2c_start(baud, addr, false);
+    if (addr != EMU_EXPANDER_ADDR) {
+        i2c_stop(start_ns);
+        return PICO_ERROR_GENERIC;
+    }
+    for (size_t i = 0; i < len; i++) {
+        i2c_byte(src[i], true);
+        vcd_set(&vcd, sig_i2c_byte, emu_now_ns, src[i]);
+        if (baud <= EMU_EXPANDER_MAX_HZ) expander_write(src[i]);
+        i2c_bytes++;
+    }
+    i2c_stop(start_ns);
+    return (int)len;
+}
+
+int emu_i2c_read(unsigned int baud, uint8_t addr, uint8_t *dst, size_t len) {
+    uint64_t start_ns = emu_now_ns;
+    i2c_start(baud, addr, true);
+    if (addr != EMU_EXPANDER_ADDR) {
+        i2c_stop(start_ns);
+        return PICO_ERROR_GENERIC;
+    }
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = baud <= EMU_EXPANDER_MAX_HZ ? expander_port : 0xFF;
+        // The master acknowledges all but the last byte
+        i2c_byte(dst[i], i + 1 < len);
+        vcd_set(&vcd, sig_i2c_byte, emu_now_ns, dst[i]);
+        i2c_bytes++;
+    }
+    i2c_stop(start_ns);
+    return (int)len;
+}
+
+/* --- Pins --- */
+void emu_gpio_changed(unsigned int pin, bool level) {
+    vcd_set(&vcd, pin_signal[pin], emu_now_ns, level);
+    if (pin == PIN_RELAY) relay_switches++;
+    if (pin == PIN_RELAY && !level) fault_relay_off();
+    if (pin == PIN_BUZZER && level) buzzer_beeps++;
+    for (size_t i = 0; i < SENSOR_COUNT; i++) {
+        if (sensors[i].cs == pin) max6675_select(&sensors[i], level);
+    }
+}
+
+/* --- Clock --- */
+static void finish(int status) {
+    vcd_close(&vcd, emu_now_ns);
+    fflush(stdout);
+    fprintf(stderr, "EMU %.3f s\n", emu_now_ns / 1e9);
+    for (int line = 0; line < 2; line++) {
+        fprintf(stderr, "EMU LCD |%.16s|%s\n", lcd.ddram[line],
+                line == 0 && !lcd.display_on ? " display off" : line == 0 && !(expander_port & LCD_BL) ? " backlight off" : "");
+    }
+    if (lcd.busy_writes) fprintf(stderr, "EMU LCD %lu nibbles lost while busy\n", (unsigned long)lcd.busy_writes);
+    double seconds = emu_now_ns / 1e9;
+    fprintf(stderr, "EMU relay %lu switches, on %.1f%%, cavity %.1fC\n", (unsigned long)relay_switches,
+            100.0 * relay_on_ns / emu_now_ns, plant.cavity);
+    fprintf(stderr, "EMU buzzer %lu beeps\n", (unsigned long)buzzer_beeps);
+    fprintf(stderr, "EMU I2C %lu transfers, %lu bytes, busy %.1f%%\n", (unsigned long)i2c_transfers,
+            (unsigned long)i2c_bytes, 100.0 * i2c_busy_ns / emu_now_ns);
+    fprintf(stderr, "EMU SPI %lu frames, %.1f/s\n", (unsigned long)spi_frames, spi_frames / seconds);
+    if (!fault_report() && status == 0) status = 1;
+    exit(status);
+}
+
+static uint64_t next_event_ns(void) {
+    uint64_t next = MIN(stop_ns, plant_next_ns);
+    if (event_next < event_count) next = MIN(next, events[event_next].at_ns);
+    uint64_t watchdog_us = sdk_watchdog_deadline_us();
+    if (watchdog_us != UINT64_MAX) next = MIN(next, watchdog_us * 1000);
+    uint64_t alarm_us = sdk_next_alarm_us();
+    if (alarm_us != UINT64_MAX) next = MIN(next, alarm_us * 1000);
+    return next;
+}
+
+static void run_due(void) {
+    while (plant_next_ns <= emu_now_ns) {
+        bool relay = sdk_gpio_out_level(PIN_RELAY);
+        plant_step(&plant, relay, EMU_PLANT_STEP_US / 1e6f);
+        if (relay) relay_on_ns += (uint64_t)EMU_PLANT_STEP_US * 1000;
+        plant_next_ns += (uint64_t)EMU_PLANT_STEP_US * 1000;
+        vcd_set_real(&vcd, sig_cavity, emu_now_ns, roundf(plant.cavity * 10) / 10);
+        vcd_set_real(&vcd, sig_element, emu_now_ns, roundf(plant.element * 10) / 10);
+    }
+    while (event_next < event_count && events[event_next].at_ns <= emu_now_ns) event_run(&events[event_next++]);
+    uint64_t watchdog_us = sdk_watchdog_deadline_us();
+    if (watchdog_us != UINT64_MAX && watchdog_us * 1000 <= emu_now_ns) {
+        fprintf(stderr, "EMU watchdog reset\n");
+        finish(1);
+    }
+    sdk_run_alarms();
+    if (emu_now_ns >= stop_ns) finish(0);
+}
+
+void emu_advance_ns(uint64_t ns) {
+    uint64_t end = emu_now_ns + ns;
+    do {
+        uint64_t next = MIN(end, next_event_ns());
+        if (next > emu_now_ns) emu_now_ns = next;
+        run_due();
+    } while (emu_now_ns < end);
+}
+
+/* --- Main --- */
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [--time S] [--vcd FILE] [--from S] [--i2c-bits] [script]\n", argv0);
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    double time_s = EMU_TIME_DEFAULT_S, from_s = 0;
+    const char *vcd_path = NULL, *script = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            time_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--vcd") == 0 && i + 1 < argc) {
+            vcd_path = argv[++i];
+        } else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            from_s = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--i2c-bits") == 0) {
+            i2c_bits = true;
+        } else if (argv[i][0] == '-' || script) {
+            usage(argv[0]);
+        } else {
+            script = argv[i];
+        }
+    }
+
+    script_load(script);
+    sdk_init();
+    plant_init(&plant, &oven, EMU_AMBIENT_C);
+    // The sensors have been converting since power-up
+    for (size_t i = 0; i < SENSOR_COUNT; i++) sensors[i].frame = max6675_convert(&sensors[i]);
+    emu_now_ns = (uint64_t)EMU_BOOT_US * 1000;
+    plant_next_ns = emu_now_ns;
+    stop_ns = (uint64_t)(time_s * 1e9);
+    trace_open(vcd_path, MAX((uint64_t)(from_s * 1e9), emu_now_ns));
+
+    // Buttons held from power-up are down before the firmware looks
+    emu_advance_ns(0);
+    firmware_main();
+    finish(0);
+}
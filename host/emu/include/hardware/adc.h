@@ -0,0 +1,23 @@
+#ifndef _HARDWARE_ADC_H
+#define _HARDWARE_ADC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t cs;
+    volatile uint32_t result;
+} adc_hw_t;
+
+extern adc_hw_t *adc_hw;
+
+#define ADC_CS_START_ONCE_BITS 0x00000004u
+#define ADC_CS_READY_BITS      0x00000100u
+
+void adc_init(void);
+void adc_set_temp_sensor_enabled(bool enable);
+void adc_select_input(unsigned int input);
+
+static inline void hw_set_bits(volatile uint32_t *addr, uint32_t mask) { *addr |= mask; }
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef _HARDWARE_CLOCKS_H
+#define _HARDWARE_CLOCKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SYS_CLK_KHZ 125000
+
+enum clock_index { clk_gpout0, clk_gpout1, clk_gpout2, clk_gpout3, clk_ref, clk_sys, clk_peri, clk_usb, clk_adc, clk_rtc };
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required);
+uint32_t clock_get_hz(enum clock_index clk_index);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+#include <stdbool.h>
+
+#define GPIO_OUT 1
+#define GPIO_IN  0
+#define NUM_BANK0_GPIOS 30
+
+enum gpio_function {
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+void gpio_init(unsigned int gpio);
+void gpio_set_function(unsigned int gpio, enum gpio_function fn);
+void gpio_set_dir(unsigned int gpio, bool out);
+void gpio_pull_up(unsigned int gpio);
+void gpio_put(unsigned int gpio, bool value);
+bool gpio_get(unsigned int gpio);
+bool gpio_get_out_level(unsigned int gpio);
+
+#endif
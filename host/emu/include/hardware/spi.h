@@ -0,0 +1,18 @@
+#ifndef _HARDWARE_SPI_H
+#define _HARDWARE_SPI_H
+
+#include "pico/stdlib.h"
+
+typedef struct spi_inst spi_inst_t;
+extern spi_inst_t *spi0, *spi1;
+
+typedef enum { SPI_CPOL_0, SPI_CPOL_1 } spi_cpol_t;
+typedef enum { SPI_CPHA_0, SPI_CPHA_1 } spi_cpha_t;
+typedef enum { SPI_LSB_FIRST, SPI_MSB_FIRST } spi_order_t;
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef _HARDWARE_TIMER_H
+#define _HARDWARE_TIMER_H
+
+#include "pico/time.h"
+
+#define NUM_TIMERS 4
+
+typedef void (*hardware_alarm_callback_t)(unsigned int alarm_num);
+
+int hardware_alarm_claim_unused(bool required);
+void hardware_alarm_unclaim(unsigned int alarm_num);
+void hardware_alarm_set_callback(unsigned int alarm_num, hardware_alarm_callback_t callback);
+/* @returns Whether the target had already passed, in which case the alarm isn't set */
+bool hardware_alarm_set_target(unsigned int alarm_num, absolute_time_t t);
+void hardware_alarm_cancel(unsigned int alarm_num);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef _HARDWARE_UART_H
+#define _HARDWARE_UART_H
+
+#include "pico/stdlib.h"
+
+typedef struct uart_inst uart_inst_t;
+extern uart_inst_t *uart0, *uart1;
+
+uint uart_init(uart_inst_t *uart, uint baudrate);
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate);
+bool uart_is_readable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len);
+void uart_tx_wait_blocking(uart_inst_t *uart);
+
+#endif
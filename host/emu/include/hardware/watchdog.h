@@ -0,0 +1,21 @@
+#ifndef _HARDWARE_WATCHDOG_H
+#define _HARDWARE_WATCHDOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t ctrl;
+    volatile uint32_t load;
+    volatile uint32_t reason;
+    volatile uint32_t scratch[8];
+    volatile uint32_t tick;
+} watchdog_hw_t;
+
+extern watchdog_hw_t *watchdog_hw;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+bool watchdog_caused_reboot(void);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+/*
+ * Host emulator stand-in for the Pico SDK: just the API the firmware uses,
+ * with the same names and signatures, implemented by host/emu/sdk.c
+ * against the emulator's virtual clock.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+#define MAX(a, b) ((a) < (b) ? (b) : (a))
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+#define PICO_OK             0
+#define PICO_ERROR_NONE     0
+#define PICO_ERROR_TIMEOUT  -1
+#define PICO_ERROR_GENERIC  -2
+
+// Flash is a host array; XIP reads go straight to it
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+extern uint8_t emu_flash[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE ((uintptr_t)emu_flash)
+
+#include "hardware/gpio.h"
+#include "pico/time.h"
+
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+
+static inline void tight_loop_contents(void) {}
+
+#endif
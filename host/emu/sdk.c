@@ -0,0 +1,461 @@
+/*
+ * The Pico SDK API used by the firmware, on the emulator's virtual clock.
+ * Blocking calls advance the clock by what they would take on the board;
+ * alarms and timers run as interrupts would, between those steps, unless
+ * interrupts are disabled.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/unique_id.h"
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/flash.h"
+#include "hardware/i2c.h"
+#include "hardware/spi.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/uart.h"
+#include "hardware/watchdog.h"
+
+#include "emu.h"
+
+#define SDK_ALARMS_MAX       16
+#define SDK_FLASH_ERASE_US   45000 // Typical 4 KB sector erase on the W25Q16
+#define SDK_FLASH_PROGRAM_US 400   // Typical 256 byte page program
+#define SDK_BOARD_TEMP_C     30.0f // What the die temperature sensor reads
+
+uint8_t emu_flash[PICO_FLASH_SIZE_BYTES];
+bool sdk_irq_enabled = true;
+static bool in_irq = false;
+static bool sdk_event = false; // The core's event register, for WFE
+
+void sdk_init(void) {
+    memset(emu_flash, 0xFF, sizeof(emu_flash));
+}
+
+/* --- Time --- */
+uint64_t time_us_64(void) { return emu_now_ns / 1000; }
+
+void sleep_us(uint64_t us) { emu_advance_ns(us * 1000); }
+
+void sleep_ms(uint32_t ms) { emu_advance_ns((uint64_t)ms * 1000000); }
+
+void sleep_until(absolute_time_t t) {
+    if (t > time_us_64()) emu_advance_ns((t - time_us_64()) * 1000);
+}
+
+/* --- Alarms and repeating timers --- */
+typedef struct Alarm {
+    alarm_id_t id;           // 0 when the slot is free
+    uint64_t at_us;
+    alarm_callback_t callback;
+    void *user_data;
+    repeating_timer_t *timer; // Set for a repeating timer
+} Alarm;
+
+static Alarm alarms[SDK_ALARMS_MAX];
+static alarm_id_t next_alarm_id = 1;
+
+static alarm_id_t alarm_add(uint64_t at_us, alarm_callback_t callback, void *user_data, repeating_timer_t *timer) {
+    for (int i = 0; i < SDK_ALARMS_MAX; i++) {
+        if (alarms[i].id) continue;
+        alarms[i] = (Alarm){next_alarm_id++, at_us, callback, user_data, timer};
+        return alarms[i].id;
+    }
+    fprintf(stderr, "EMU alarm pool full\n");
+    return -1;
+}
+
+alarm_id_t add_alarm_at(absolute_time_t time, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    if (time <= time_us_64()) {
+        if (!fire_if_past) return 0;
+        int64_t again = callback(0, user_data);
+        if (again == 0) return 0;
+        time = again > 0 ? time + (uint64_t)again : time_us_64() + (uint64_t)-again;
+    }
+    return alarm_add(time, callback, user_data, NULL);
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return add_alarm_at(time_us_64() + us, callback, user_data, fire_if_past);
+}
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data, bool fire_if_past) {
+    return add_alarm_at(time_us_64() + (uint64_t)ms * 1000, callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t alarm_id) {
+    for (int i = 0; i < SDK_ALARMS_MAX; i++) {
+        if (alarm_id && alarms[i].id == alarm_id) {
+            alarms[i].id = 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+    out->delay_us = delay_us;
+    out->callback = callback;
+    out->user_data = user_data;
+    out->alarm_id = alarm_add(time_us_64() + (uint64_t)(delay_us < 0 ? -delay_us : delay_us), NULL, NULL, out);
+    return out->alarm_id > 0;
+}
+
+bool add_repeating_timer_ms(int32_t delay_ms, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+    return add_repeating_timer_us((int64_t)delay_ms * 1000, callback, user_data, out);
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+    bool cancelled = cancel_alarm(timer->alarm_id);
+    timer->alarm_id = 0;
+    return cancelled;
+}
+
+/* --- Hardware alarms --- */
+typedef struct HardwareAlarm {
+    bool claimed;
+    bool armed;
+    uint64_t at_us;
+    hardware_alarm_callback_t callback;
+} HardwareAlarm;
+
+static HardwareAlarm hardware_alarms[NUM_TIMERS];
+
+int hardware_alarm_claim_unused(bool required) {
+    // Alarm 3 belongs to the SDK's alarm pool
+    for (int i = 0; i < NUM_TIMERS - 1; i++) {
+        if (hardware_alarms[i].claimed) continue;
+        hardware_alarms[i].claimed = true;
+        return i;
+    }
+    if (required) fprintf(stderr, "EMU no free hardware alarm\n");
+    return -1;
+}
+
+void hardware_alarm_unclaim(unsigned int alarm_num) {
+    hardware_alarms[alarm_num] = (HardwareAlarm){0};
+}
+
+void hardware_alarm_set_callback(unsigned int alarm_num, hardware_alarm_callback_t callback) {
+    hardware_alarms[alarm_num].callback = callback;
+}
+
+bool hardware_alarm_set_target(unsigned int alarm_num, absolute_time_t t) {
+    HardwareAlarm *a = &hardware_alarms[alarm_num];
+    if (t <= time_us_64()) {
+        a->armed = false;
+        return true;
+    }
+    a->armed = true;
+    a->at_us = t;
+    return false;
+}
+
+void hardware_alarm_cancel(unsigned int alarm_num) {
+    hardware_alarms[alarm_num].armed = false;
+}
+
+uint64_t sdk_next_alarm_us(void) {
+    uint64_t next = UINT64_MAX;
+    if (!sdk_irq_enabled || in_irq) return next;
+    for (int i = 0; i < SDK_ALARMS_MAX; i++) {
+        if (alarms[i].id) next = MIN(next, alarms[i].at_us);
+    }
+    for (int i = 0; i < NUM_TIMERS; i++) {
+        if (hardware_alarms[i].armed) next = MIN(next, hardware_alarms[i].at_us);
+    }
+    return next;
+}
+
+// Runs one pool alarm or timer; it may cancel itself or add others meanwhile
+static void alarm_fire(Alarm *a) {
+    Alarm fired = *a;
+    uint64_t now = time_us_64();
+    if (fired.timer) {
+        repeating_timer_t *rt = fired.timer;
+        bool again = rt->callback(rt);
+        if (a->id != fired.id) return;
+        if (!again) {
+            a->id = 0;
+            rt->alarm_id = 0;
+            return;
+        }
+        // Negative delays count from the start of the callback, positive from its end
+        a->at_us = rt->delay_us < 0 ? fired.at_us + (uint64_t)-rt->delay_us : time_us_64() + (uint64_t)rt->delay_us;
+        return;
+    }
+    int64_t again = fired.callback(fired.id, fired.user_data);
+    if (a->id != fired.id) return;
+    if (again == 0) {
+        a->id = 0;
+    } else {
+        a->at_us = again > 0 ? fired.at_us + (uint64_t)again : now + (uint64_t)-again;
+    }
+}
+
+void sdk_run_alarms(void) {
+    if (!sdk_irq_enabled || in_irq) return;
+    in_irq = true;
+    for (;;) {
+        uint64_t now = time_us_64();
+        Alarm *due = NULL;
+        HardwareAlarm *due_hw = NULL;
+        uint64_t first = now + 1;
+        for (int i = 0; i < SDK_ALARMS_MAX; i++) {
+            if (alarms[i].id && alarms[i].at_us < first) {
+                first = alarms[i].at_us;
+                due = &alarms[i];
+            }
+        }
+        for (int i = 0; i < NUM_TIMERS; i++) {
+            if (hardware_alarms[i].armed && hardware_alarms[i].at_us < first) {
+                first = hardware_alarms[i].at_us;
+                due_hw = &hardware_alarms[i];
+                due = NULL;
+            }
+        }
+        // Any interrupt ends a WFE
+        sdk_event = true;
+        if (due_hw) {
+            due_hw->armed = false;
+            if (due_hw->callback) due_hw->callback((unsigned int)(due_hw - hardware_alarms));
+        } else if (due) {
+            alarm_fire(due);
+        } else {
+            break;
+        }
+    }
+    in_irq = false;
+}
+
+/* --- Interrupts --- */
+void __sev(void) { sdk_event = true; }
+
+void __wfe(void) {
+    // Nothing but an alarm can set the event, so time skips to the next one
+    while (!sdk_event) {
+        uint64_t next = sdk_next_alarm_us(), now = time_us_64();
+        emu_advance_ns(next == UINT64_MAX || next <= now ? 1000000 : (next - now) * 1000);
+    }
+    sdk_event = false;
+}
+
+uint32_t save_and_disable_interrupts(void) {
+    uint32_t status = sdk_irq_enabled;
+    sdk_irq_enabled = false;
+    return status;
+}
+
+void restore_interrupts(uint32_t status) {
+    sdk_irq_enabled = status;
+    // Anything that fell due meanwhile fires now
+    if (status) emu_advance_ns(0);
+}
+
+/* --- GPIO --- */
+static bool gpio_out_level[NUM_BANK0_GPIOS];
+static bool gpio_is_out[NUM_BANK0_GPIOS];
+
+void gpio_init(unsigned int gpio) {
+    gpio_is_out[gpio] = false;
+    gpio_out_level[gpio] = false;
+}
+
+void gpio_set_function(unsigned int gpio, enum gpio_function fn) { (void)gpio, (void)fn; }
+
+void gpio_set_dir(unsigned int gpio, bool out) { gpio_is_out[gpio] = out; }
+
+void gpio_pull_up(unsigned int gpio) { (void)gpio; }
+
+void gpio_put(unsigned int gpio, bool value) {
+    if (gpio_out_level[gpio] == value) return;
+    gpio_out_level[gpio] = value;
+    emu_gpio_changed(gpio, value);
+}
+
+bool gpio_get(unsigned int gpio) {
+    return gpio_is_out[gpio] ? gpio_out_level[gpio] : emu_gpio_input(gpio);
+}
+
+bool gpio_get_out_level(unsigned int gpio) { return gpio_out_level[gpio]; }
+
+bool sdk_gpio_out_level(unsigned int pin) { return gpio_out_level[pin]; }
+
+/* --- Clocks --- */
+static uint32_t sys_khz = SYS_CLK_KHZ;
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required) {
+    (void)required;
+    sys_khz = freq_khz;
+    return true;
+}
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    (void)clk_index;
+    return sys_khz * 1000;
+}
+
+/* --- SPI --- */
+struct spi_inst {
+    uint baud;
+};
+
+static spi_inst_t spi_insts[2];
+spi_inst_t *spi0 = &spi_insts[0], *spi1 = &spi_insts[1];
+
+uint spi_set_baudrate(spi_inst_t *spi, uint baudrate) {
+    // The peripheral clock follows clk_sys and divides by at least 2
+    spi->baud = MIN(baudrate, sys_khz * 500);
+    return spi->baud;
+}
+
+uint spi_init(spi_inst_t *spi, uint baudrate) { return spi_set_baudrate(spi, baudrate); }
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order) {
+    (void)spi, (void)data_bits, (void)cpol, (void)cpha, (void)order;
+}
+
+int spi_read_blocking(spi_inst_t *spi, uint8_t repeated_tx_data, uint8_t *dst, size_t len) {
+    (void)repeated_tx_data;
+    emu_spi_read(spi->baud, dst, len);
+    return (int)len;
+}
+
+/* --- I2C --- */
+struct i2c_inst {
+    uint baud;
+};
+
+static i2c_inst_t i2c_insts[2];
+i2c_inst_t *i2c0 = &i2c_insts[0], *i2c1 = &i2c_insts[1];
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate) {
+    i2c->baud = baudrate;
+    return baudrate;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) { return i2c_set_baudrate(i2c, baudrate); }
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+    (void)nostop;
+    return emu_i2c_write(i2c->baud, addr, src, len);
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+    (void)nostop;
+    return emu_i2c_read(i2c->baud, addr, dst, len);
+}
+
+// Devices on the bus never stretch the clock, so the timeouts can't expire
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us) {
+    (void)timeout_us;
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+int i2c_write_timeout_per_char_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                                  uint timeout_per_char_us) {
+    (void)timeout_per_char_us;
+    return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us) {
+    (void)timeout_us;
+    return i2c_read_blocking(i2c, addr, dst, len, nostop);
+}
+
+/* --- UART --- */
+// Nothing else is on the power bus, so only the transmit time matters
+struct uart_inst {
+    uint baud;
+};
+
+static uart_inst_t uart_insts[2];
+uart_inst_t *uart0 = &uart_insts[0], *uart1 = &uart_insts[1];
+
+uint uart_set_baudrate(uart_inst_t *uart, uint baudrate) {
+    uart->baud = baudrate;
+    return baudrate;
+}
+
+uint uart_init(uart_inst_t *uart, uint baudrate) { return uart_set_baudrate(uart, baudrate); }
+
+bool uart_is_readable(uart_inst_t *uart) {
+    (void)uart;
+    return false;
+}
+
+char uart_getc(uart_inst_t *uart) {
+    (void)uart;
+    return 0;
+}
+
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len) {
+    (void)src;
+    emu_advance_ns((uint64_t)len * 10 * 1000000000u / uart->baud);
+}
+
+void uart_tx_wait_blocking(uart_inst_t *uart) { (void)uart; }
+
+/* --- Flash --- */
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    memset(emu_flash + flash_offs, 0xFF, count);
+    emu_advance_ns((uint64_t)(count / FLASH_SECTOR_SIZE) * SDK_FLASH_ERASE_US * 1000);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    // Programming can only clear bits
+    for (size_t i = 0; i < count; i++) emu_flash[flash_offs + i] &= data[i];
+    emu_advance_ns((uint64_t)(count / FLASH_PAGE_SIZE) * SDK_FLASH_PROGRAM_US * 1000);
+}
+
+/* --- ADC --- */
+// RP2040 datasheet: 0.706V at 27C, -1.721mV/C, on a 12-bit 3.3V scale
+static adc_hw_t adc_regs = {
+    .cs = ADC_CS_READY_BITS,
+    .result = (uint32_t)((0.706f - (SDK_BOARD_TEMP_C - 27.0f) * 0.001721f) / 3.3f * 4096.0f + 0.5f),
+};
+adc_hw_t *adc_hw = &adc_regs;
+
+void adc_init(void) {}
+
+void adc_set_temp_sensor_enabled(bool enable) { (void)enable; }
+
+void adc_select_input(unsigned int input) { (void)input; }
+
+/* --- Watchdog --- */
+static watchdog_hw_t watchdog_regs;
+watchdog_hw_t *watchdog_hw = &watchdog_regs;
+static uint64_t watchdog_period_us = 0;
+static uint64_t watchdog_deadline_us = UINT64_MAX;
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) {
+    (void)pause_on_debug;
+    watchdog_period_us = (uint64_t)delay_ms * 1000;
+    watchdog_update();
+}
+
+void watchdog_update(void) {
+    if (watchdog_period_us) watchdog_deadline_us = time_us_64() + watchdog_period_us;
+}
+
+bool watchdog_caused_reboot(void) { return false; }
+
+uint64_t sdk_watchdog_deadline_us(void) { return watchdog_deadline_us; }
+
+/* --- Board --- */
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out) {
+    static const uint8_t id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES] = {0xE6, 0x60, 0x00, 0x00, 0x45, 0x4D, 0x55, 0x01};
+    memcpy(id_out->id, id, sizeof(id));
+}
+
+bool stdio_init_all(void) { return true; }
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    int c = emu_console_getc();
+    if (c >= 0) return c;
+    if (timeout_us) emu_advance_ns((uint64_t)timeout_us * 1000);
+    return PICO_ERROR_TIMEOUT;
+}
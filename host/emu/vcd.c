@@ -0,0 +1,108 @@
+#include <string.h>
+
+#include "vcd.h"
+
+bool vcd_open(Vcd *v, const char *path, uint64_t start_ns) {
+    *v = (Vcd){0};
+    v->f = fopen(path, "w");
+    if (!v->f) return false;
+    v->start_ns = start_ns;
+    fprintf(v->f, "$version Smart-Toaster emulator $end\n$timescale 1ns $end\n");
+    return true;
+}
+
+void vcd_scope(Vcd *v, const char *name) {
+    if (v->scope) fprintf(v->f, "$upscope $end\n");
+    fprintf(v->f, "$scope module %s $end\n", name);
+    v->scope = name;
+}
+
+int vcd_signal(Vcd *v, const char *name, int width) {
+    if (v->count == VCD_SIGNALS_MAX) return -1;
+    int id = v->count++;
+    VcdSignal *s = &v->signals[id];
+    // Identifier codes are printable ASCII from '!'
+    int n = id;
+    int len = 0;
+    do {
+        s->code[len++] = (char)('!' + n % 94);
+        n /= 94;
+    } while (n && len < 3);
+    s->width = width;
+    if (width == 0) {
+        fprintf(v->f, "$var real 64 %s %s $end\n", s->code, name);
+    } else if (width == 1) {
+        fprintf(v->f, "$var wire 1 %s %s $end\n", s->code, name);
+    } else {
+        fprintf(v->f, "$var wire %d %s %s [%d:0] $end\n", width, s->code, name, width - 1);
+    }
+    return id;
+}
+
+void vcd_header_done(Vcd *v) {
+    if (v->scope) fprintf(v->f, "$upscope $end\n");
+    fprintf(v->f, "$enddefinitions $end\n");
+}
+
+static void write_value(Vcd *v, const VcdSignal *s) {
+    if (s->width == 0) {
+        if (s->known) fprintf(v->f, "r%.6g %s\n", s->real, s->code);
+        else fprintf(v->f, "rNaN %s\n", s->code);
+    } else if (s->width == 1) {
+        fprintf(v->f, "%c%s\n", !s->known ? 'x' : s->value ? '1' : '0', s->code);
+    } else {
+        char bits[33];
+        for (int i = 0; i < s->width; i++) bits[i] = !s->known ? 'x' : (s->value >> (s->width - 1 - i)) & 1 ? '1' : '0';
+        bits[s->width] = '\0';
+        fprintf(v->f, "b%s %s\n", bits, s->code);
+    }
+}
+
+// Dumps every value once the first change after the start time comes along
+static void start(Vcd *v) {
+    v->started = true;
+    v->last_ns = v->start_ns;
+    fprintf(v->f, "#%llu\n$dumpvars\n", (unsigned long long)v->start_ns);
+    for (int i = 0; i < v->count; i++) write_value(v, &v->signals[i]);
+    fprintf(v->f, "$end\n");
+}
+
+// Writes the timestamp for a change at now_ns; false up to the start time
+static bool advance(Vcd *v, uint64_t now_ns) {
+    if (now_ns <= v->start_ns) return false;
+    if (!v->started) start(v);
+    if (now_ns > v->last_ns) {
+        v->last_ns = now_ns;
+        fprintf(v->f, "#%llu\n", (unsigned long long)now_ns);
+    }
+    return true;
+}
+
+void vcd_set(Vcd *v, int signal, uint64_t now_ns, uint32_t value) {
+    if (!v->f || signal < 0) return;
+    VcdSignal *s = &v->signals[signal];
+    if (s->width < 32) value &= (1u << s->width) - 1;
+    if (s->known && s->value == value) return;
+    if (now_ns > v->start_ns && !v->started) start(v);
+    s->known = true;
+    s->value = value;
+    if (advance(v, now_ns)) write_value(v, s);
+}
+
+void vcd_set_real(Vcd *v, int signal, uint64_t now_ns, double value) {
+    if (!v->f || signal < 0) return;
+    VcdSignal *s = &v->signals[signal];
+    if (s->known && s->real == value) return;
+    if (now_ns > v->start_ns && !v->started) start(v);
+    s->known = true;
+    s->real = value;
+    if (advance(v, now_ns)) write_value(v, s);
+}
+
+void vcd_close(Vcd *v, uint64_t now_ns) {
+    if (!v->f) return;
+    if (!v->started) start(v);
+    advance(v, now_ns);
+    fclose(v->f);
+    v->f = NULL;
+}
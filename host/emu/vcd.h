@@ -0,0 +1,59 @@
+#ifndef VCD_H
+#define VCD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Value change dump writer, as read by GTKWave. Signals are declared up
+ * front, then changed in time order; a change to the value a signal
+ * already has writes nothing. Time is in nanoseconds.
+ *
+ * Changes up to the start time are tracked but not written, and the
+ * values they leave are dumped at the start time.
+ */
+
+#define VCD_SIGNALS_MAX 48
+
+typedef struct VcdSignal {
+    char code[4];
+    int width;      // 0 for a real
+    bool known;     // False until first set, dumped as x
+    uint32_t value;
+    double real;
+} VcdSignal;
+
+typedef struct Vcd {
+    FILE *f;
+    uint64_t start_ns;
+    uint64_t last_ns;     // Last timestamp written
+    bool started;         // Header done and initial values dumped
+    const char *scope;    // Scope of the signals being declared
+    int count;
+    VcdSignal signals[VCD_SIGNALS_MAX];
+} Vcd;
+
+/* @returns false if the file can't be created */
+bool vcd_open(Vcd *v, const char *path, uint64_t start_ns);
+
+/* Starts a scope; signals declared after it belong to it */
+void vcd_scope(Vcd *v, const char *name);
+
+/**
+ * Declares a signal in the current scope.
+ * @param width Bits, or 0 for a real
+ * @returns Its handle, or -1 past VCD_SIGNALS_MAX
+ */
+int vcd_signal(Vcd *v, const char *name, int width);
+
+/* Ends the declarations */
+void vcd_header_done(Vcd *v);
+
+void vcd_set(Vcd *v, int signal, uint64_t now_ns, uint32_t value);
+void vcd_set_real(Vcd *v, int signal, uint64_t now_ns, double value);
+
+/* Marks the end time and closes the file */
+void vcd_close(Vcd *v, uint64_t now_ns);
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * Fleet statistics from cycle log dumps.
+ *
+ * Reads TRACE.BIN files copied off the units' USB drives (a CycleLogHeader
+ * followed by records, see cycle_log.h), from any number of files or
+ * directories, and prints one row per unit:
+ *
+ *   fleet_stats [-j threads] [--json | --cycles] [--watts W] path ...
+ *
+ * Dumps are memory-mapped and decoded on every core, then each unit's
+ * records from all of its dumps are merged by sequence number, so
+ * overlapping dumps of the same unit count each cycle once. --cycles prints
+ * the merged records instead, in the USB export's CSV format with the unit
+ * prepended.
+ *
+ * Element degradation shows up as a falling preheat heating rate over the
+ * unit's life. The rate is the rise from the coolest reading to the bottom
+ * of the band over the preheat time, taken from bake cycles that started
+ * cold, so it doesn't depend on the setpoint. Energy is the relay duty
+ * times ELEMENT_WATTS unless --watts says otherwise.
+ */
+#define _GNU_SOURCE // nftw, getopt_long, madvise
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "control.h"
+#include "cycle_log.h"
+#include "oven_profile.h"
+
+#define PREHEAT_MIN_RISE_C    50.0f // Bake cycles starting warmer than this under target are skipped
+#define DEGRADE_MIN_SAMPLES   20
+#define DEGRADE_PCT_PER_1000  -3.0 // Heating rate trend that flags the element
+
+/* --- Inputs --- */
+typedef struct Dump {
+    char *path;
+    uint8_t unit_id[8];
+    CycleLogRecord *records; // Valid records only
+    uint32_t count;
+    uint32_t invalid;        // Records failing their checksum
+    const char *error;       // NULL if the file decoded
+} Dump;
+
+static Dump *dumps = NULL;
+static size_t dump_count = 0, dump_cap = 0;
+
+static void add_dump(const char *path) {
+    if (dump_count == dump_cap) {
+        dump_cap = dump_cap ? dump_cap * 2 : 256;
+        dumps = realloc(dumps, dump_cap * sizeof(Dump));
+        if (!dumps) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    dumps[dump_count++] = (Dump){.path = strdup(path)};
+}
+
+static int add_tree_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    if (type == FTW_F) add_dump(path);
+    return 0;
+}
+
+/* Decodes one dump. Runs on a worker thread and touches nothing but d. */
+static void decode_dump(Dump *d) {
+    int fd = open(d->path, O_RDONLY);
+    if (fd < 0) {
+        d->error = strerror(errno);
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CycleLogHeader)) {
+        d->error = "too short for a header";
+        close(fd);
+        return;
+    }
+    size_t size = (size_t)st.st_size;
+    const uint8_t *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        d->error = strerror(errno);
+        return;
+    }
+    madvise((void *)map, size, MADV_SEQUENTIAL);
+
+    const CycleLogHeader *h = (const CycleLogHeader *)map;
+    if (h->magic != CYCLE_LOG_MAGIC || h->record_size != sizeof(CycleLogRecord)) {
+        d->error = "not a cycle log";
+    } else if (h->version == 0 || h->version > CYCLE_LOG_VERSION) {
+        d->error = "unknown log version";
+    } else {
+        // The export pads the file to whole sectors; count says how many are real
+        size_t n = (size - sizeof(CycleLogHeader)) / sizeof(CycleLogRecord);
+        if (h->count < n) n = h->count;
+        memcpy(d->unit_id, h->unit_id, sizeof(d->unit_id));
+        d->records = malloc((n ? n : 1) * sizeof(CycleLogRecord));
+        const CycleLogRecord *r = (const CycleLogRecord *)(map + sizeof(CycleLogHeader));
+        for (size_t i = 0; i < n; i++) {
+            if (cycle_log_record_valid(&r[i])) d->records[d->count++] = r[i];
+            else d->invalid++;
+        }
+    }
+    munmap((void *)map, size);
+}
+
+/* --- Worker pool --- */
+typedef struct ParallelFor {
+    size_t n;
+    atomic_size_t next;
+    void (*fn)(size_t i);
+} ParallelFor;
+
+static void *parallel_worker(void *arg) {
+    ParallelFor *p = arg;
+    for (size_t i; (i = atomic_fetch_add(&p->next, 1)) < p->n;) p->fn(i);
+    return NULL;
+}
+
+/* Runs fn(0..n-1) across threads; items are handed out one at a time */
+static void parallel_for(size_t n, int threads, void (*fn)(size_t i)) {
+    ParallelFor p = {.n = n, .fn = fn};
+    atomic_init(&p.next, 0);
+    pthread_t tids[threads];
+    int started = 0;
+    for (; started < threads - 1; started++) {
+        if (pthread_create(&tids[started], NULL, parallel_worker, &p) != 0) break;
+    }
+    parallel_worker(&p);
+    for (int i = 0; i < started; i++) pthread_join(tids[i], NULL);
+}
+
+/* --- Units --- */
+typedef struct Unit {
+    char id[17];
+    uint32_t dumps;
+    CycleLogRecord *records; // Merged by seq, duplicates dropped
+    uint32_t count;
+    uint32_t invalid;
+
+    uint32_t completed, stopped, faults;
+    uint32_t seq_gaps;       // Cycles missing between dumps
+    uint32_t first_wall, last_wall;
+    double energy_wh;
+    uint32_t eco_cycles;
+    double eco_saved_wh;
+
+    uint32_t preheats;
+    double preheat_s;        // Mean over qualifying bake cycles
+    double preheat_trend_s;  // Change per 1000 cycles
+    double heat_rate;        // Mean, C/min
+    double heat_rate_trend;  // Percent of the mean per 1000 cycles
+} Unit;
+
+static Unit *units = NULL;
+static size_t unit_count = 0;
+static float element_watts = ELEMENT_WATTS;
+
+static int compare_dump_unit(const void *a, const void *b) {
+    const Dump *x = a, *y = b;
+    if (x->error || y->error) return (x->error != NULL) - (y->error != NULL);
+    return memcmp(x->unit_id, y->unit_id, sizeof(x->unit_id));
+}
+
+static int compare_seq(const void *a, const void *b) {
+    uint32_t x = ((const CycleLogRecord *)a)->seq, y = ((const CycleLogRecord *)b)->seq;
+    return (x > y) - (x < y);
+}
+
+/* Groups decoded dumps by unit. Dumps must be sorted by compare_dump_unit. */
+static void group_units(void) {
+    units = calloc(dump_count ? dump_count : 1, sizeof(Unit));
+    for (size_t i = 0; i < dump_count && !dumps[i].error;) {
+        size_t j = i;
+        uint32_t total = 0;
+        while (j < dump_count && !dumps[j].error && compare_dump_unit(&dumps[i], &dumps[j]) == 0) total += dumps[j++].count;
+
+        Unit *u = &units[unit_count++];
+        for (int k = 0; k < 8; k++) snprintf(u->id + 2 * k, 3, "%02x", dumps[i].unit_id[k]);
+        u->dumps = (uint32_t)(j - i);
+        u->records = malloc((total ? total : 1) * sizeof(CycleLogRecord));
+        for (; i < j; i++) {
+            memcpy(u->records + u->count, dumps[i].records, dumps[i].count * sizeof(CycleLogRecord));
+            u->count += dumps[i].count;
+            u->invalid += dumps[i].invalid;
+        }
+    }
+}
+
+/* Least-squares slope of y against x */
+static double slope(const double *x, const double *y, uint32_t n) {
+    double mx = 0, my = 0, sxx = 0, sxy = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        mx += x[i];
+        my += y[i];
+    }
+    mx /= n;
+    my /= n;
+    for (uint32_t i = 0; i < n; i++) {
+        sxx += (x[i] - mx) * (x[i] - mx);
+        sxy += (x[i] - mx) * (y[i] - my);
+    }
+    return sxx > 0 ? sxy / sxx : 0;
+}
+
+/* Merges and summarises one unit. Runs on a worker thread. */
+static void analyse_unit(size_t index) {
+    Unit *u = &units[index];
+    qsort(u->records, u->count, sizeof(CycleLogRecord), compare_seq);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < u->count; i++) {
+        if (kept && u->records[kept - 1].seq == u->records[i].seq) continue;
+        if (kept) u->seq_gaps += u->records[i].seq - u->records[kept - 1].seq - 1;
+        u->records[kept++] = u->records[i];
+    }
+    u->count = kept;
+
+    u->first_wall = u->last_wall = CYCLE_LOG_NO_WALL_TIME;
+    double *seq = malloc((kept ? kept : 1) * sizeof(double));
+    double *preheat = malloc((kept ? kept : 1) * sizeof(double));
+    double *rate = malloc((kept ? kept : 1) * sizeof(double));
+
+    for (uint32_t i = 0; i < kept; i++) {
+        const CycleLogRecord *r = &u->records[i];
+        const CycleSummary *c = &r->summary;
+        u->completed += r->result == CYCLE_COMPLETED;
+        u->stopped += r->result == CYCLE_STOPPED;
+        u->faults += r->result == CYCLE_FAULT;
+        if (r->wall_time != CYCLE_LOG_NO_WALL_TIME) {
+            if (u->first_wall == CYCLE_LOG_NO_WALL_TIME) u->first_wall = r->wall_time;
+            u->last_wall = r->wall_time;
+        }
+        u->energy_wh += c->duty_pct / 100.0 * c->duration_ms / 3.6e6 * element_watts;
+        if (r->controller == CONTROL_ECO && r->eco_saved_dwh != CYCLE_LOG_NO_ECO) {
+            u->eco_cycles++;
+            u->eco_saved_wh += r->eco_saved_dwh / 10.0;
+        }
+
+        float rise = r->target - TEMP_HYSTERESIS - c->min_temp;
+        if (r->mode == 1 && r->result != CYCLE_FAULT && c->preheat_ms != UINT32_MAX && c->preheat_ms > 0 &&
+            rise >= PREHEAT_MIN_RISE_C) {
+            seq[u->preheats] = r->seq;
+            preheat[u->preheats] = c->preheat_ms / 1000.0;
+            rate[u->preheats] = rise / (c->preheat_ms / 60000.0);
+            u->preheat_s += preheat[u->preheats];
+            u->heat_rate += rate[u->preheats];
+            u->preheats++;
+        }
+    }
+
+    if (u->preheats) {
+        u->preheat_s /= u->preheats;
+        u->heat_rate /= u->preheats;
+        u->preheat_trend_s = slope(seq, preheat, u->preheats) * 1000;
+        u->heat_rate_trend = slope(seq, rate, u->preheats) * 1000 / u->heat_rate * 100;
+    }
+    free(seq);
+    free(preheat);
+    free(rate);
+}
+
+static const char *element_state(const Unit *u) {
+    if (u->preheats < DEGRADE_MIN_SAMPLES) return "unknown";
+    return u->heat_rate_trend <= DEGRADE_PCT_PER_1000? "degrading" : "ok";
+}
+
+/* --- Output --- */
+static void format_wall(uint32_t t, char *buf, size_t len) {
+    buf[0] = 0;
+    if (t == CYCLE_LOG_NO_WALL_TIME) return;
+    time_t tt = (time_t)t;
+    struct tm tm;
+    gmtime_r(&tt, &tm);
+    strftime(buf, len, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+static void print_units_csv(void) {
+    printf("unit,dumps,cycles,invalid,missing,completed,stopped,faults,first_wall,last_wall,"
+           "energy_wh,energy_wh_per_cycle,eco_cycles,eco_saved_wh,preheats,preheat_s,preheat_trend_s_per_1000,"
+           "heat_rate_c_per_min,heat_rate_trend_pct_per_1000,element\n");
+    for (size_t i = 0; i < unit_count; i++) {
+        const Unit *u = &units[i];
+        char first[24], last[24];
+        format_wall(u->first_wall, first, sizeof(first));
+        format_wall(u->last_wall, last, sizeof(last));
+        printf("%s,%u,%u,%u,%u,%u,%u,%u,%s,%s,%.1f,%.2f,%u,%.1f,%u,%.1f,%.2f,%.2f,%.2f,%s\n", u->id, u->dumps,
+               u->count, u->invalid, u->seq_gaps, u->completed, u->stopped, u->faults, first, last, u->energy_wh,
+               u->count ? u->energy_wh / u->count : 0, u->eco_cycles, u->eco_saved_wh, u->preheats, u->preheat_s,
+               u->preheat_trend_s, u->heat_rate, u->heat_rate_trend, element_state(u));
+    }
+}
+
+static void print_units_json(void) {
+    printf("[\n");
+    for (size_t i = 0; i < unit_count; i++) {
+        const Unit *u = &units[i];
+        char first[24], last[24];
+        format_wall(u->first_wall, first, sizeof(first));
+        format_wall(u->last_wall, last, sizeof(last));
+        printf("  {\"unit\": \"%s\", \"dumps\": %u, \"cycles\": %u, \"invalid\": %u, \"missing\": %u, "
+               "\"completed\": %u, \"stopped\": %u, \"faults\": %u, \"first_wall\": \"%s\", \"last_wall\": \"%s\", "
+               "\"energy_wh\": %.1f, \"energy_wh_per_cycle\": %.2f, \"eco_cycles\": %u, \"eco_saved_wh\": %.1f, "
+               "\"preheats\": %u, \"preheat_s\": %.1f, \"preheat_trend_s_per_1000\": %.2f, "
+               "\"heat_rate_c_per_min\": %.2f, \"heat_rate_trend_pct_per_1000\": %.2f, \"element\": \"%s\"}%s\n",
+               u->id, u->dumps, u->count, u->invalid, u->seq_gaps, u->completed, u->stopped, u->faults, first, last,
+               u->energy_wh, u->count ? u->energy_wh / u->count : 0, u->eco_cycles, u->eco_saved_wh, u->preheats,
+               u->preheat_s, u->preheat_trend_s, u->heat_rate, u->heat_rate_trend, element_state(u),
+               i + 1 < unit_count ? "," : "");
+    }
+    printf("]\n");
+}
+
+static void print_cycles_csv(void) {
+    printf("unit,%s\n", CYCLE_LOG_CSV_HEADER);
+    char row[256];
+    for (size_t i = 0; i < unit_count; i++) {
+        for (uint32_t j = 0; j < units[i].count; j++) {
+            cycle_log_format_csv(&units[i].records[j], row, sizeof(row));
+            printf("%s,%s\n", units[i].id, row);
+        }
+    }
+}
+
+static void decode_dump_at(size_t i) { decode_dump(&dumps[i]); }
+
+int main(int argc, char **argv) {
+    enum { OUT_CSV, OUT_JSON, OUT_CYCLES } out = OUT_CSV;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    static const struct option options[] = {
+        {"json", no_argument, NULL, 'J'},
+        {"cycles", no_argument, NULL, 'C'},
+        {"watts", required_argument, NULL, 'w'},
+        {0},
+    };
+    for (int opt; (opt = getopt_long(argc, argv, "j:", options, NULL)) != -1;) {
+        switch (opt) {
+            case 'j': threads = strtol(optarg, NULL, 10); break;
+            case 'J': out = OUT_JSON; break;
+            case 'C': out = OUT_CYCLES; break;
+            case 'w': element_watts = strtof(optarg, NULL); break;
+            default:
+                fprintf(stderr, "usage: %s [-j threads] [--json | --cycles] [--watts W] path ...\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind == argc) {
+        fprintf(stderr, "%s: no dumps given\n", argv[0]);
+        return 2;
+    }
+    if (threads < 1) threads = 1;
+
+    for (int i = optind; i < argc; i++) {
+        struct stat st;
+        if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+            nftw(argv[i], add_tree_entry, 16, FTW_PHYS);
+        } else {
+            add_dump(argv[i]);
+        }
+    }
+
+    parallel_for(dump_count, (int)threads, decode_dump_at);
+    size_t failed = 0;
+    for (size_t i = 0; i < dump_count; i++) {
+        if (!dumps[i].error) continue;
+        fprintf(stderr, "%s: %s\n", dumps[i].path, dumps[i].error);
+        failed++;
+    }
+
+    qsort(dumps, dump_count, sizeof(Dump), compare_dump_unit);
+    group_units();
+    parallel_for(unit_count, (int)threads, analyse_unit);
+
+    switch (out) {
+        case OUT_CSV: print_units_csv(); break;
+        case OUT_JSON: print_units_json(); break;
+        case OUT_CYCLES: print_cycles_csv(); break;
+    }
+    fprintf(stderr, "%zu dumps, %zu units, %zu unreadable\n", dump_count, unit_count, failed);
+    return failed == dump_count ? 1 : 0;
+}
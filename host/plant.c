@@ -0,0 +1,58 @@
+#include <math.h>
+
+#include "plant.h"
+
+void plant_init(Plant *pl, const PlantParams *p, float ambient) {
+    *pl = (Plant){0};
+    pl->p = *p;
+    pl->ambient = ambient;
+    pl->element = ambient;
+    pl->cavity = ambient;
+    pl->probe = ambient;
+    pl->element_probe = ambient;
+    pl->load = ambient;
+}
+
+void plant_add_load(Plant *pl, const PlantLoad *l) {
+    pl->load_j_per_c = l->j_per_c;
+    pl->load_w_per_c = l->w_per_c;
+    pl->load = l->start_c;
+    pl->load_water_g = l->water_g;
+}
+
+void plant_remove_load(Plant *pl) {
+    pl->load_j_per_c = 0;
+    pl->load_water_g = 0;
+}
+
+// Warms the load by heat_j, boiling off water at the plateau
+static void load_heat(Plant *pl, float heat_j) {
+    if (pl->load_water_g > 0 && pl->load + heat_j / pl->load_j_per_c >= PLANT_EVAPORATE_C) {
+        float warm_j = fmaxf(0, (PLANT_EVAPORATE_C - pl->load) * pl->load_j_per_c);
+        pl->load_water_g -= (heat_j - warm_j) / PLANT_LATENT_J_PER_G;
+        pl->load = fmaxf(pl->load, PLANT_EVAPORATE_C);
+        if (pl->load_water_g < 0) {
+            // Dried out part way through the step; the rest heats the load
+            pl->load += -pl->load_water_g * PLANT_LATENT_J_PER_G / pl->load_j_per_c;
+            pl->load_water_g = 0;
+        }
+        return;
+    }
+    pl->load += heat_j / pl->load_j_per_c;
+}
+
+void plant_step(Plant *pl, bool relay, float dt_s) {
+    const PlantParams *p = &pl->p;
+    float heat = relay ? p->watts : 0;
+    float coupled = p->coupling_w_per_c * (pl->element - pl->cavity);
+    float loss = (p->loss_w_per_c + (pl->door_open ? PLANT_DOOR_LOSS_W_PER_C : 0)) * (pl->cavity - pl->ambient);
+    float to_load = pl->load_j_per_c > 0 ? pl->load_w_per_c * (pl->cavity - pl->load) : 0;
+
+    pl->element += (heat - coupled) * dt_s / p->element_j_per_c;
+    pl->cavity += (coupled - loss - to_load) * dt_s / p->cavity_j_per_c;
+    if (pl->load_j_per_c > 0) load_heat(pl, to_load * dt_s);
+
+    pl->probe += (pl->cavity - pl->probe) * dt_s / p->probe_tau_s;
+    pl->element_probe += (pl->element - pl->element_probe) * dt_s / p->element_probe_tau_s;
+    pl->energy_j += heat * dt_s;
+}
@@ -0,0 +1,69 @@
+#ifndef PLANT_H
+#define PLANT_H
+
+#include <stdbool.h>
+
+/*
+ * Simulated oven for host benchmarks.
+ *
+ * The same two masses the MPC models (element and cavity, the cavity
+ * including its walls), plus what the model leaves out: thermocouple lag
+ * on both probes, extra loss while the door is open, and an optional load
+ * that soaks up heat from the cavity. Celsius, seconds and watts.
+ *
+ * A load is one lumped mass behind a surface coupling. Any water in it
+ * holds it at PLANT_EVAPORATE_C, taking heat as steam, until it has boiled
+ * off; that plateau is what makes real food slow to finish.
+ */
+
+#define PLANT_DOOR_LOSS_W_PER_C 40.0f   // Extra cavity loss with the door open
+#define PLANT_EVAPORATE_C       100.0f  // Where a load's water boils off
+#define PLANT_LATENT_J_PER_G    2260.0f // Heat of vaporisation of water
+
+typedef struct PlantParams {
+    const char *name;
+    float element_j_per_c;
+    float cavity_j_per_c;
+    float coupling_w_per_c;
+    float loss_w_per_c;
+    float watts;
+    float probe_tau_s;         // Cavity thermocouple lag
+    float element_probe_tau_s; // Element thermocouple lag
+} PlantParams;
+
+typedef struct PlantLoad {
+    const char *name;
+    float j_per_c;   // Thermal mass, its water included
+    float w_per_c;   // Surface coupling to the cavity
+    float water_g;   // Boiled off at PLANT_EVAPORATE_C before the load heats further
+    float start_c;   // Temperature when put in
+} PlantLoad;
+
+typedef struct Plant {
+    PlantParams p;
+    float ambient;
+    float element;
+    float cavity;
+    float probe;           // What the cavity thermocouple reads
+    float element_probe;
+    bool door_open;
+    float load_j_per_c;    // 0 when there is no load
+    float load_w_per_c;
+    float load;
+    float load_water_g;    // Left to boil off
+    double energy_j;       // Drawn by the element so far
+} Plant;
+
+/* Starts with everything at ambient */
+void plant_init(Plant *pl, const PlantParams *p, float ambient);
+
+/* Puts a load into the cavity, replacing any already in */
+void plant_add_load(Plant *pl, const PlantLoad *l);
+
+/* Takes the load out */
+void plant_remove_load(Plant *pl);
+
+/* Advances by dt_s with the relay held as given */
+void plant_step(Plant *pl, bool relay, float dt_s);
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * Shared power budget over pseudo-terminals.
+ *
+ * Runs several ovens in one process, each a thread with its own PowerBus
+ * (power_bus.c, as the firmware runs it) talking through the slave side of
+ * its own pty. A hub thread plays the shared line: every byte written by
+ * one unit is delivered to all of them, the sender included, as on a
+ * half-duplex RS-485 pair.
+ *
+ *   power_bus_sim [-n units] [-t seconds] [-b budget_w]
+ *
+ * Every unit preheats a simulated oven (host/plant.c) to the same target
+ * and then holds it with a bang-bang band, asking the bus before each
+ * switch-on like power_budget_allows does. The bus runs in real time; the
+ * ovens run PLANT_SPEEDUP times faster so a preheat fits in seconds.
+ *
+ * The main thread samples the relays every millisecond. It exits non-zero
+ * if the ovens together drew more than the budget for longer than
+ * OVER_BUDGET_MAX_PCT of the run; brief overlaps while units that
+ * disagreed on the ranking hear each other are expected.
+ */
+#define _GNU_SOURCE // posix_openpt, ptsname, cfmakeraw
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "oven_profile.h"
+#include "plant.h"
+#include "power_bus.h"
+
+#define UNITS_DEFAULT       4
+#define UNITS_MAX           POWER_BUS_MAX_PEERS
+#define RUN_S_DEFAULT       12
+#define LOOP_MS             20     // As the firmware's main loop
+#define PLANT_SPEEDUP       60
+#define TARGET_C            175.0f
+#define AMBIENT_C           25.0f
+#define OVER_BUDGET_MAX_PCT 1.0
+
+static const PlantParams oven = {"reference", MODEL_ELEMENT_J_PER_C, MODEL_CAVITY_J_PER_C, MODEL_COUPLING_W_PER_C,
+                                 MODEL_LOSS_W_PER_C, ELEMENT_WATTS, 8.0f, 2.0f};
+
+typedef struct Unit {
+    int master;            // Hub side of the pty
+    int slave;             // Unit side
+    pthread_t tid;
+    PowerBus bus;
+    Plant plant;
+    atomic_bool relay;
+    float preheat_s;       // Oven time to reach the band, negative until then
+    uint32_t denied;       // Loop passes that wanted heat and were refused
+} Unit;
+
+static Unit units[UNITS_MAX];
+static int unit_count = UNITS_DEFAULT;
+static atomic_bool stopping;
+
+static uint32_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void sleep_ms(uint32_t ms) {
+    nanosleep(&(struct timespec){ms / 1000, (long)(ms % 1000) * 1000000}, NULL);
+}
+
+/* Opens a pty with the line discipline off, so frames pass byte for byte */
+static bool unit_open(Unit *u) {
+    u->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (u->master < 0 || grantpt(u->master) != 0 || unlockpt(u->master) != 0) return false;
+    u->slave = open(ptsname(u->master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (u->slave < 0) return false;
+    struct termios t;
+    if (tcgetattr(u->slave, &t) != 0) return false;
+    cfmakeraw(&t);
+    return tcsetattr(u->slave, TCSANOW, &t) == 0;
+}
+
+/* One oven's main loop: the bus task, then the relay decision */
+static void *unit_run(void *arg) {
+    Unit *u = arg;
+    bool demand = false;
+    float oven_s = 0;
+    while (!atomic_load(&stopping)) {
+        uint32_t now = now_ms();
+        bool relay = atomic_load(&u->relay);
+
+        uint8_t rx[64];
+        ssize_t n;
+        while ((n = read(u->slave, rx, sizeof(rx))) > 0) {
+            for (ssize_t i = 0; i < n; i++) power_bus_receive(&u->bus, rx[i], now);
+        }
+        uint8_t frame[POWER_BUS_FRAME_LEN];
+        if (power_bus_poll_tx(&u->bus, now, frame) && write(u->slave, frame, sizeof(frame)) != sizeof(frame)) {
+            perror("unit write");
+        }
+
+        float probe = u->plant.probe;
+        if (probe < TARGET_C - TEMP_HYSTERESIS) demand = true;
+        if (probe > TARGET_C + TEMP_HYSTERESIS) demand = false;
+        if (u->preheat_s < 0 && probe >= TARGET_C - TEMP_HYSTERESIS) u->preheat_s = oven_s;
+
+        power_bus_set_demand(&u->bus, demand, TARGET_C - probe, relay, now);
+        relay = demand && power_bus_may_heat(&u->bus, now);
+        if (demand && !relay) u->denied++;
+        atomic_store(&u->relay, relay);
+
+        float dt_s = LOOP_MS / 1000.0f * PLANT_SPEEDUP;
+        plant_step(&u->plant, relay, dt_s);
+        oven_s += dt_s;
+        sleep_ms(LOOP_MS);
+    }
+    return NULL;
+}
+
+/* The shared line: whatever any unit sends, every unit hears */
+static void *hub_run(void *arg) {
+    (void)arg;
+    struct pollfd fds[UNITS_MAX];
+    for (int i = 0; i < unit_count; i++) fds[i] = (struct pollfd){.fd = units[i].master, .events = POLLIN};
+    while (!atomic_load(&stopping)) {
+        if (poll(fds, (nfds_t)unit_count, 10) <= 0) continue;
+        for (int i = 0; i < unit_count; i++) {
+            if (!(fds[i].revents & POLLIN)) continue;
+            uint8_t buf[256];
+            ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+            if (n <= 0) continue;
+            for (int j = 0; j < unit_count; j++) {
+                if (write(units[j].master, buf, (size_t)n) != n) perror("hub write");
+            }
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int run_s = RUN_S_DEFAULT;
+    uint32_t budget_w = POWER_BUS_BUDGET_W;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:b:")) != -1) {
+        switch (opt) {
+            case 'n': unit_count = atoi(optarg); break;
+            case 't': run_s = atoi(optarg); break;
+            case 'b': budget_w = (uint32_t)atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n units] [-t seconds] [-b budget_w]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (unit_count < 1 || unit_count > UNITS_MAX || run_s < 1) {
+        fprintf(stderr, "%s: 1 to %d units for at least a second\n", argv[0], UNITS_MAX);
+        return 2;
+    }
+
+    for (int i = 0; i < unit_count; i++) {
+        Unit *u = &units[i];
+        if (!unit_open(u)) {
+            perror("pty");
+            return 2;
+        }
+        power_bus_init(&u->bus, (uint16_t)(0x100 + i), ELEMENT_WATTS, budget_w, now_ms());
+        plant_init(&u->plant, &oven, AMBIENT_C);
+        atomic_init(&u->relay, false);
+        u->preheat_s = -1;
+    }
+
+    pthread_t hub;
+    pthread_create(&hub, NULL, hub_run, NULL);
+    for (int i = 0; i < unit_count; i++) pthread_create(&units[i].tid, NULL, unit_run, &units[i]);
+
+    // Sample the total draw against the budget
+    uint32_t samples = 0, over = 0, peak_w = 0;
+    uint64_t drawn_w = 0;
+    uint32_t end = now_ms() + (uint32_t)run_s * 1000;
+    while ((int32_t)(now_ms() - end) < 0) {
+        uint32_t w = 0;
+        for (int i = 0; i < unit_count; i++) w += atomic_load(&units[i].relay) ? ELEMENT_WATTS : 0;
+        samples++;
+        drawn_w += w;
+        if (w > budget_w) over++;
+        if (w > peak_w) peak_w = w;
+        sleep_ms(1);
+    }
+    atomic_store(&stopping, true);
+    for (int i = 0; i < unit_count; i++) pthread_join(units[i].tid, NULL);
+    pthread_join(hub, NULL);
+
+    printf("%d units of %d W on a %lu W budget, %d s (oven time x%d)\n", unit_count, ELEMENT_WATTS,
+           (unsigned long)budget_w, run_s, PLANT_SPEEDUP);
+    printf("%-6s %10s %8s %8s %8s %7s\n", "unit", "preheat s", "heated", "denied", "rx", "bad");
+    for (int i = 0; i < unit_count; i++) {
+        Unit *u = &units[i];
+        char preheat[16] = "-";
+        if (u->preheat_s >= 0) snprintf(preheat, sizeof(preheat), "%.0f", u->preheat_s);
+        float oven_s = (float)run_s * PLANT_SPEEDUP;
+        printf("%04x   %10s %7.1f%% %8lu %8lu %7lu\n", u->bus.self.unit, preheat,
+               100.0 * u->plant.energy_j / (ELEMENT_WATTS * oven_s), (unsigned long)u->denied,
+               (unsigned long)u->bus.frames_rx, (unsigned long)u->bus.frames_bad);
+    }
+    double over_pct = 100.0 * over / samples;
+    printf("draw mean %.0f W, peak %lu W, over budget %.2f%% of the time\n", (double)drawn_w / samples,
+           (unsigned long)peak_w, over_pct);
+    if (over_pct > OVER_BUDGET_MAX_PCT) {
+        printf("FAIL over budget for more than %.1f%% of the time\n", OVER_BUDGET_MAX_PCT);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
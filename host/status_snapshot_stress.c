@@ -0,0 +1,133 @@
+/*
+ * Stress test for status_snapshot.h.
+ *
+ * One writer thread publishes control states the way the main loop does,
+ * while reader threads take snapshots the way the supervisor IRQ (a single
+ * attempt) and the status command (a few attempts) do. Every field of a
+ * published state is derived from one counter, so a reader can tell a torn
+ * copy from a consistent one. Both sides sleep or spin for random short
+ * times to shake out interleavings.
+ *
+ *   status_snapshot_stress [writes]
+ *
+ * Built with ThreadSanitizer, which also reports any data race in the
+ * protocol itself. Exits non-zero if a reader ever saw a torn snapshot.
+ */
+#define _GNU_SOURCE // rand_r
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "status_snapshot.h"
+
+#define WRITES_DEFAULT 200000
+#define READERS        4
+
+static StatusSnapshot snapshot;
+static atomic_bool writer_done;
+
+/* The state published for counter n; every field changes with n */
+static ControlStatus status_for(uint32_t n) {
+    return (ControlStatus){
+        .temp = (float)(n % 4000) * 0.25f,
+        .time_target_ms = -(int32_t)n,
+        .temp_target = (int16_t)(n % 30000),
+        .stage = (uint8_t)(n % 5),
+        .flags = (uint8_t)(n & (CONTROL_STATUS_RUNNING | CONTROL_STATUS_RELAY)),
+    };
+}
+
+static bool status_consistent(const ControlStatus *s) {
+    uint32_t n = (uint32_t)-s->time_target_ms;
+    ControlStatus want = status_for(n);
+    return s->temp == want.temp && s->temp_target == want.temp_target && s->stage == want.stage &&
+           s->flags == want.flags;
+}
+
+/* Waits a random short time: mostly nothing, sometimes a spin or a sleep */
+static void random_delay(unsigned *seed) {
+    int r = rand_r(seed) % 100;
+    if (r < 80) return;
+    if (r < 98) {
+        for (volatile int i = rand_r(seed) % 500; i > 0; i--) {}
+        return;
+    }
+    nanosleep(&(struct timespec){0, 1000 + rand_r(seed) % 20000}, NULL);
+}
+
+typedef struct Reader {
+    pthread_t tid;
+    int attempts;
+    unsigned seed;
+    uint64_t reads;
+    uint64_t failed;  // Every attempt overlapped a write
+    uint64_t torn;
+    uint32_t last_n;
+    uint64_t backwards; // Snapshots older than one already seen
+} Reader;
+
+static void *reader_run(void *arg) {
+    Reader *r = arg;
+    while (!atomic_load_explicit(&writer_done, memory_order_relaxed)) {
+        ControlStatus s;
+        r->reads++;
+        if (!status_snapshot_read(&snapshot, &s, r->attempts)) {
+            r->failed++;
+        } else if (!status_consistent(&s)) {
+            r->torn++;
+        } else {
+            uint32_t n = (uint32_t)-s.time_target_ms;
+            if (n < r->last_n) r->backwards++;
+            r->last_n = n;
+        }
+        random_delay(&r->seed);
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    uint32_t writes = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : WRITES_DEFAULT;
+    status_snapshot_init(&snapshot);
+    ControlStatus first = status_for(0);
+    status_snapshot_publish(&snapshot, &first);
+
+    // Half the readers behave like the IRQ, half like the status command
+    Reader readers[READERS] = {0};
+    for (int i = 0; i < READERS; i++) {
+        readers[i].attempts = i % 2 ? 3 : 1;
+        readers[i].seed = (unsigned)time(NULL) * 31u + (unsigned)i;
+        if (pthread_create(&readers[i].tid, NULL, reader_run, &readers[i]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
+
+    unsigned seed = (unsigned)time(NULL);
+    for (uint32_t n = 1; n <= writes; n++) {
+        ControlStatus s = status_for(n);
+        status_snapshot_publish(&snapshot, &s);
+        random_delay(&seed);
+    }
+    atomic_store(&writer_done, true);
+
+    uint64_t torn = 0, backwards = 0;
+    for (int i = 0; i < READERS; i++) {
+        Reader *r = &readers[i];
+        pthread_join(r->tid, NULL);
+        printf("reader %d (%d attempts): %llu reads, %llu failed, %llu torn, %llu out of order\n", i, r->attempts,
+               (unsigned long long)r->reads, (unsigned long long)r->failed, (unsigned long long)r->torn,
+               (unsigned long long)r->backwards);
+        torn += r->torn;
+        backwards += r->backwards;
+    }
+    if (torn || backwards) {
+        printf("FAIL %llu torn, %llu out of order\n", (unsigned long long)torn, (unsigned long long)backwards);
+        return 1;
+    }
+    printf("OK %lu writes\n", (unsigned long)writes);
+    return 0;
+}
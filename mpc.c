@@ -0,0 +1,153 @@
+#include "mpc.h"
+
+#define TO_FIXED(t) ((int32_t)((t) * (1 << MPC_TEMP_SHIFT) + ((t) < 0 ? -0.5f : 0.5f)))
+
+void mpc_model_init(MpcModel *m, float element_j_per_c, float cavity_j_per_c,
+                    float coupling_w_per_c, float loss_w_per_c, float watts) {
+    float dt = MPC_QUANTUM_MS / 1000.0f;
+    m->heat = TO_FIXED(watts * dt / element_j_per_c);
+    m->element_k = (int32_t)(coupling_w_per_c * dt / element_j_per_c * 65536.0f + 0.5f);
+    m->cavity_k = (int32_t)(coupling_w_per_c * dt / cavity_j_per_c * 65536.0f + 0.5f);
+    m->loss_k = (int32_t)(loss_w_per_c * dt / cavity_j_per_c * 65536.0f + 0.5f);
+}
+
+void mpc_init(Mpc *c, const MpcModel *model, uint32_t switch_penalty) {
+    *c = (Mpc){0};
+    c->model = *model;
+    c->switch_penalty = switch_penalty;
+}
+
+void mpc_set_economy(Mpc *c, uint32_t energy_penalty, uint8_t over_shift, float shadow_hysteresis) {
+    c->energy_penalty = energy_penalty;
+    c->over_shift = over_shift;
+    c->shadow_band = TO_FIXED(shadow_hysteresis);
+}
+
+void mpc_reset(Mpc *c, float cavity, float ambient) {
+    c->cavity = TO_FIXED(cavity);
+    c->element = c->cavity;
+    c->ambient = TO_FIXED(ambient);
+    c->relay = false;
+    c->shadow_element = c->shadow_cavity = 0;
+    c->shadow_relay = false;
+    c->on_quanta = c->shadow_on_quanta = 0;
+}
+
+/* Q16 multiply, rounded. Gaps stay under 2^15 (2048 C) and coefficients under 2^16. */
+static inline int32_t qmul(int32_t gap, int32_t k) {
+    return (gap * k + 32768) >> 16;
+}
+
+static inline void model_step(const MpcModel *m, int32_t *element, int32_t *cavity, int32_t ambient, bool on) {
+    int32_t gap = *element - *cavity;
+    *element += (on ? m->heat : 0) - qmul(gap, m->element_k);
+    *cavity += qmul(gap, m->cavity_k) - qmul(*cavity - ambient, m->loss_k);
+}
+
+#define STEP_COST_MAX (4095u * 4095u)
+
+/* Squared error in quarter degrees; clamped so a horizon of them fits 32 bits */
+static inline uint32_t step_cost(int32_t cavity, int32_t ref, uint8_t over_shift) {
+    int32_t err = (cavity - ref) >> (MPC_TEMP_SHIFT - 2);
+    if (err > 4095) err = 4095;
+    if (err < -4095) err = -4095;
+    uint32_t cost = (uint32_t)(err * err);
+    if (err > 0 && over_shift) {
+        cost <<= over_shift; // Under 2^24 before, over_shift is at most 7
+        if (cost > STEP_COST_MAX) cost = STEP_COST_MAX;
+    }
+    return cost;
+}
+
+/*
+ * Advances the fixed-band shadow by one quantum. The model is linear, so
+ * the shadow is kept as its difference from the real oven, driven only by
+ * the difference in relay; whatever else happened to the cavity (the door,
+ * a load) happened to both and cancels.
+ */
+static void shadow_step(Mpc *c, int32_t measured, int32_t ref) {
+    const MpcModel *m = &c->model;
+    if (c->shadow_relay) c->shadow_on_quanta++;
+    int32_t gap = c->shadow_element - c->shadow_cavity;
+    c->shadow_element += ((int32_t)c->shadow_relay - (int32_t)c->relay) * m->heat - qmul(gap, m->element_k);
+    c->shadow_cavity += qmul(gap, m->cavity_k) - qmul(c->shadow_cavity, m->loss_k);
+
+    int32_t cavity = measured + c->shadow_cavity;
+    if (cavity <= ref - c->shadow_band) c->shadow_relay = true;
+    else if (cavity >= ref + c->shadow_band) c->shadow_relay = false;
+}
+
+bool mpc_step(Mpc *c, float cavity, float ref, float ref_rate, float ref_final, uint32_t remaining_ms) {
+    const MpcModel *m = &c->model;
+
+    // Last quantum's prediction against the reading. The cavity estimate
+    // takes the reading; the element, which nothing measures, takes the blame.
+    if (c->relay) c->on_quanta++;
+    model_step(m, &c->element, &c->cavity, c->ambient, c->relay);
+    int32_t measured = TO_FIXED(cavity);
+    c->element += (measured - c->cavity) * MPC_OBSERVER_GAIN;
+    c->cavity = measured;
+    if (c->element < c->cavity) c->element = c->cavity;
+    if (c->shadow_band) shadow_step(c, measured, TO_FIXED(ref));
+
+    // Nothing after the end of the cycle is worth heating for
+    uint32_t quanta_left = remaining_ms / MPC_QUANTUM_MS;
+    int horizon = quanta_left < MPC_HORIZON ? (int)quanta_left : MPC_HORIZON;
+    if (horizon == 0) {
+        c->cost = 0;
+        c->plan_on_first = true;
+        c->plan_switch = 0;
+        c->relay = false;
+        return false;
+    }
+
+    int32_t refs[MPC_HORIZON];
+    int32_t r = TO_FIXED(ref), r_final = TO_FIXED(ref_final);
+    int32_t r_step = TO_FIXED(ref_rate * (MPC_QUANTUM_MS / 1000.0f));
+    for (int j = 0; j < horizon; j++) {
+        r += r_step;
+        if ((r_step > 0 && r > r_final) || (r_step < 0 && r < r_final)) r = r_final;
+        refs[j] = r_step ? r : r_final;
+    }
+
+    uint32_t best = UINT32_MAX;
+    for (int first = 0; first < 2; first++) {
+        bool on_first = first == 0;
+
+        // The first k quanta are shared by every plan that switches at k or
+        // later, so walk them once and branch off at each k
+        int32_t e = c->element, t = c->cavity;
+        uint32_t prefix = 0;
+        for (int k = 0; k <= horizon; k++) {
+            uint32_t switches = (k > 0 && on_first != c->relay) + (k < horizon && k > 0) + (k == 0 && !on_first != c->relay);
+            // Only the quantum being decided pays for its energy; charging
+            // the whole plan would make every plan end in a long coast that
+            // it then overheats to pay for
+            bool heat_now = k > 0 ? on_first : !on_first;
+            uint32_t cost = prefix + switches * c->switch_penalty + (heat_now ? c->energy_penalty : 0);
+            int32_t be = e, bt = t;
+            for (int j = k; j < horizon && cost < best; j++) {
+                model_step(m, &be, &bt, c->ambient, !on_first);
+                cost += step_cost(bt, refs[j], c->over_shift);
+            }
+            if (cost < best) {
+                best = cost;
+                c->plan_on_first = on_first;
+                c->plan_switch = (uint8_t)k;
+            }
+
+            if (k == horizon) break;
+            model_step(m, &e, &t, c->ambient, on_first);
+            prefix += step_cost(t, refs[k], c->over_shift);
+            if (prefix >= best) break; // Every later k costs at least this much
+        }
+    }
+
+    c->cost = best;
+    c->relay = c->plan_switch > 0 ? c->plan_on_first : !c->plan_on_first;
+    return c->relay;
+}
+
+float mpc_energy_saved_j(const Mpc *c, float watts) {
+    return ((float)c->shadow_on_quanta - (float)c->on_quanta) * watts * (MPC_QUANTUM_MS / 1000.0f);
+}
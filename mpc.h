@@ -0,0 +1,112 @@
+#ifndef MPC_H
+#define MPC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Small-horizon model predictive control of the relay.
+ *
+ * Every MPC_QUANTUM_MS the controller corrects its model state with the
+ * cavity reading, then scores relay plans over the next MPC_HORIZON quanta
+ * against the reference trajectory: on for k quanta then off, or off for k
+ * then on, for every k. A mechanical relay only ever wants one of these
+ * shapes over a window shorter than the oven's lag. The cost is squared
+ * tracking error plus a penalty per switch, and the first quantum of the
+ * cheapest plan is applied before everything is re-planned. Plans never
+ * look past the end of the cycle.
+ *
+ * The model is two thermal masses: the element, heated by the relay and
+ * coupled to the cavity, and the cavity, losing heat to ambient. The
+ * element temperature isn't measured, so it is pulled along by the cavity
+ * prediction error.
+ *
+ * Economy (the "eco" controller) adds a cost per quantum of heating and
+ * weights error above the reference more than error below it, so the plan
+ * holds at the bottom of the band, never overshoots, and coasts through
+ * the last minutes of a cycle on stored heat. Alongside it the model runs
+ * a fixed band on the same oven, to price what normal control would have
+ * drawn.
+ *
+ * All planning runs in fixed point: temperatures in 1/16 C and model
+ * coefficients in Q16, chosen so every product fits 32 bits (the M0+ has
+ * no 64-bit multiply). Floats are only used at the interface.
+ *
+ * No SDK dependencies, shared with host benchmarks.
+ */
+
+#define MPC_QUANTUM_MS  2000
+#define MPC_HORIZON     60    // Quanta; two minutes at 2 s
+#define MPC_TEMP_SHIFT  4     // 1/16 C
+#define MPC_OBSERVER_GAIN 2   // Element correction per unit of cavity prediction error
+#define MPC_NO_END      UINT32_MAX
+
+typedef struct MpcModel {
+    int32_t heat;       // Element rise per quantum at full power, 1/16 C
+    int32_t element_k;  // Q16: fraction of the element-cavity gap the element loses per quantum
+    int32_t cavity_k;   // Q16: fraction of that gap the cavity gains per quantum
+    int32_t loss_k;     // Q16: fraction of the cavity-ambient gap lost per quantum
+} MpcModel;
+
+typedef struct Mpc {
+    MpcModel model;
+    uint32_t switch_penalty; // Cost of one relay switch, in (1/4 C)^2 quanta
+    int32_t element;         // Estimated element temperature, 1/16 C
+    int32_t cavity;          // Predicted cavity temperature, 1/16 C
+    int32_t ambient;
+    bool relay;
+    uint32_t cost;           // Cost of the chosen plan, for diagnostics
+    uint8_t plan_on_first;   // Chosen plan shape
+    uint8_t plan_switch;     // Quanta until its switch; MPC_HORIZON for none
+
+    // Economy; all zero when off
+    uint32_t energy_penalty; // Cost of one quantum of heating
+    uint8_t over_shift;      // Error above the reference costs 2^over_shift more
+    int32_t shadow_band;     // Half band of the fixed-band shadow, 1/16 C
+    int32_t shadow_element;  // Shadow minus this oven, 1/16 C
+    int32_t shadow_cavity;
+    bool shadow_relay;
+    uint32_t on_quanta;      // Quanta heated this cycle
+    uint32_t shadow_on_quanta;
+} Mpc;
+
+/**
+ * Builds the per-quantum model from physical parameters.
+ * @param element_j_per_c Element heat capacity
+ * @param cavity_j_per_c Cavity heat capacity, including the walls
+ * @param coupling_w_per_c Element-to-cavity conductance
+ * @param loss_w_per_c Cavity-to-ambient conductance
+ * @param watts Element power
+ */
+void mpc_model_init(MpcModel *m, float element_j_per_c, float cavity_j_per_c,
+                    float coupling_w_per_c, float loss_w_per_c, float watts);
+
+/* @param switch_penalty In squared quarter-degrees, summed over the horizon */
+void mpc_init(Mpc *c, const MpcModel *model, uint32_t switch_penalty);
+
+/**
+ * Turns on economy. A quantum of heating then has to buy back
+ * energy_penalty of squared error to be worth it.
+ * @param shadow_hysteresis Half band of the fixed band it is compared against
+ */
+void mpc_set_economy(Mpc *c, uint32_t energy_penalty, uint8_t over_shift, float shadow_hysteresis);
+
+/* Starts a cycle from a cavity that has been left alone (element at cavity temperature) */
+void mpc_reset(Mpc *c, float cavity, float ambient);
+
+/**
+ * Plans one quantum. Call every MPC_QUANTUM_MS and hold the result until
+ * the next call.
+ * @param ref Reference now; it moves at ref_rate C/s until it reaches ref_final
+ * @param remaining_ms Until the cycle ends, or MPC_NO_END
+ * @returns Whether the relay should be on for this quantum
+ */
+bool mpc_step(Mpc *c, float cavity, float ref, float ref_rate, float ref_final, uint32_t remaining_ms);
+
+/**
+ * Heating economy has avoided this cycle, against the fixed-band shadow.
+ * Negative when it used more.
+ */
+float mpc_energy_saved_j(const Mpc *c, float watts);
+
+#endif
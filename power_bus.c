@@ -0,0 +1,164 @@
+#include "power_bus.h"
+
+#include <string.h>
+
+/* CRC-8, polynomial 0x07 */
+static uint8_t crc8(const uint8_t *data, size_t len) {
+    uint8_t crc = 0;
+    while (len--) {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++) crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+size_t power_bus_encode(const PowerBusFrame *frame, uint8_t out[POWER_BUS_FRAME_LEN]) {
+    out[0] = POWER_BUS_SYNC;
+    out[1] = (uint8_t)frame->unit;
+    out[2] = (uint8_t)(frame->unit >> 8);
+    out[3] = frame->flags;
+    out[4] = frame->priority;
+    out[5] = (uint8_t)frame->load_w;
+    out[6] = (uint8_t)(frame->load_w >> 8);
+    out[7] = frame->seq;
+    out[8] = crc8(out, POWER_BUS_FRAME_LEN - 1);
+    return POWER_BUS_FRAME_LEN;
+}
+
+bool power_bus_decode(const uint8_t in[POWER_BUS_FRAME_LEN], PowerBusFrame *frame) {
+    if (in[0] != POWER_BUS_SYNC || crc8(in, POWER_BUS_FRAME_LEN - 1) != in[POWER_BUS_FRAME_LEN - 1]) return false;
+    frame->unit = (uint16_t)(in[1] | (in[2] << 8));
+    frame->flags = in[3];
+    frame->priority = in[4];
+    frame->load_w = (uint16_t)(in[5] | (in[6] << 8));
+    frame->seq = in[7];
+    return true;
+}
+
+void power_bus_init(PowerBus *bus, uint16_t unit, uint16_t load_w, uint32_t budget_w, uint32_t now_ms) {
+    memset(bus, 0, sizeof(*bus));
+    bus->self.unit = unit;
+    bus->self.load_w = load_w;
+    bus->budget_w = budget_w;
+    bus->listen_until_ms = now_ms + POWER_BUS_LISTEN_MS;
+    bus->next_tx_ms = now_ms;
+}
+
+void power_bus_set_demand(PowerBus *bus, bool demand, float deficit, bool heating, uint32_t now_ms) {
+    bool had_demand = bus->self.flags & POWER_BUS_FLAG_DEMAND;
+    if (demand && (!had_demand || heating)) bus->wait_since_ms = now_ms;
+
+    int priority = 0;
+    if (demand) {
+        int d = deficit < 0 ? 0 : deficit > 255 ? 255 : (int)deficit;
+        priority = 255 - d + (int)((now_ms - bus->wait_since_ms) / 1000);
+        if (heating) priority += POWER_BUS_HOLD_BONUS;
+        if (priority > 255) priority = 255;
+    }
+
+    bus->self.flags = (demand ? POWER_BUS_FLAG_DEMAND : 0) | (heating ? POWER_BUS_FLAG_HEATING : 0);
+    bus->self.priority = (uint8_t)priority;
+}
+
+static bool peer_fresh(const PowerBusPeer *p, uint32_t now_ms) {
+    return now_ms - p->heard_ms <= POWER_BUS_PEER_TIMEOUT_MS;
+}
+
+void power_bus_receive(PowerBus *bus, uint8_t byte, uint32_t now_ms) {
+    if (bus->rx_len == 0 && byte != POWER_BUS_SYNC) return;
+    bus->rx[bus->rx_len++] = byte;
+    if (bus->rx_len < POWER_BUS_FRAME_LEN) return;
+
+    PowerBusFrame frame;
+    if (!power_bus_decode(bus->rx, &frame)) {
+        // Resynchronise on the next sync byte inside the rejected window
+        bus->frames_bad++;
+        uint8_t i = 1;
+        while (i < POWER_BUS_FRAME_LEN && bus->rx[i] != POWER_BUS_SYNC) i++;
+        bus->rx_len = POWER_BUS_FRAME_LEN - i;
+        memmove(bus->rx, bus->rx + i, bus->rx_len);
+        return;
+    }
+    bus->rx_len = 0;
+    bus->frames_rx++;
+    if (frame.unit == bus->self.unit) return; // Our own echo on a shared line
+
+    // Update the peer, or take the slot of a stale one
+    PowerBusPeer *slot = NULL;
+    for (int i = 0; i < bus->peer_count; i++) {
+        if (bus->peers[i].frame.unit == frame.unit) {
+            slot = &bus->peers[i];
+            break;
+        }
+        if (!slot && !peer_fresh(&bus->peers[i], now_ms)) slot = &bus->peers[i];
+    }
+    if (!slot) {
+        if (bus->peer_count == POWER_BUS_MAX_PEERS) return;
+        slot = &bus->peers[bus->peer_count++];
+    }
+    slot->frame = frame;
+    slot->heard_ms = now_ms;
+}
+
+bool power_bus_poll_tx(PowerBus *bus, uint32_t now_ms, uint8_t out[POWER_BUS_FRAME_LEN]) {
+    if ((int32_t)(now_ms - bus->next_tx_ms) < 0) return false;
+
+    // Jitter the period per unit so colliding senders drift apart
+    uint32_t jitter = (uint32_t)(bus->self.unit * 31u + bus->self.seq * 17u) % (POWER_BUS_PERIOD_MS / 5);
+    bus->next_tx_ms = now_ms + POWER_BUS_PERIOD_MS - POWER_BUS_PERIOD_MS / 10 + jitter;
+    bus->self.seq++;
+    power_bus_encode(&bus->self, out);
+    return true;
+}
+
+/* Orders a before b: higher priority first, then lower unit id */
+static bool ranks_before(const PowerBusFrame *a, const PowerBusFrame *b) {
+    if (a->priority != b->priority) return a->priority > b->priority;
+    return a->unit < b->unit;
+}
+
+bool power_bus_may_heat(PowerBus *bus, uint32_t now_ms) {
+    if (!(bus->self.flags & POWER_BUS_FLAG_DEMAND)) return false;
+    if ((int32_t)(now_ms - bus->listen_until_ms) < 0) return false;
+
+    // Walk demanding units in rank order, handing out the budget
+    const PowerBusFrame *ranked[POWER_BUS_MAX_PEERS + 1];
+    int n = 0;
+    ranked[n++] = &bus->self;
+    for (int i = 0; i < bus->peer_count; i++) {
+        const PowerBusPeer *p = &bus->peers[i];
+        if (!peer_fresh(p, now_ms) || !(p->frame.flags & POWER_BUS_FLAG_DEMAND)) continue;
+        int j = n++;
+        while (j > 0 && ranks_before(&p->frame, ranked[j - 1])) {
+            ranked[j] = ranked[j - 1];
+            j--;
+        }
+        ranked[j] = &p->frame;
+    }
+
+    uint32_t used = 0;
+    bool winner = false;
+    for (int i = 0; i < n; i++) {
+        if (used + ranked[i]->load_w > bus->budget_w) break;
+        used += ranked[i]->load_w;
+        if (ranked[i] == &bus->self) {
+            winner = true;
+            break;
+        }
+    }
+    if (!winner) return false;
+
+    // Don't switch on until peers that lost their slot have switched off
+    uint32_t committed = bus->self.load_w;
+    for (int i = 0; i < bus->peer_count; i++) {
+        const PowerBusPeer *p = &bus->peers[i];
+        if (peer_fresh(p, now_ms) && (p->frame.flags & POWER_BUS_FLAG_HEATING)) committed += p->frame.load_w;
+    }
+    return (bus->self.flags & POWER_BUS_FLAG_HEATING) || committed <= bus->budget_w;
+}
+
+int power_bus_active_peers(const PowerBus *bus, uint32_t now_ms) {
+    int n = 0;
+    for (int i = 0; i < bus->peer_count; i++) n += peer_fresh(&bus->peers[i], now_ms);
+    return n;
+}
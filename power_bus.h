@@ -0,0 +1,102 @@
+#ifndef POWER_BUS_H
+#define POWER_BUS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Shared power budget between ovens on one circuit.
+ *
+ * Every unit periodically broadcasts its heater demand, element load and a
+ * priority on a shared serial line (half-duplex, RS-485 ready). Each unit
+ * keeps a table of recently heard peers and runs the same ranking over it:
+ * demanding units sorted by priority (ties by unit id) take heater slots
+ * until the budget is used up. Since all units rank the same data the same
+ * way, they agree on who heats without a master.
+ *
+ * Priority favours the unit closest to its setpoint (shortest remaining
+ * preheat first, which minimises mean preheat time) and ages while a unit
+ * waits, so a cold oven is never starved.
+ *
+ * A unit that has just started hasn't heard anyone yet and would rank
+ * itself alone, so it listens for POWER_BUS_LISTEN_MS before taking a
+ * slot. Otherwise every oven on a circuit coming back from an outage
+ * would switch on together.
+ *
+ * No SDK dependencies: the caller supplies bytes and a millisecond clock.
+ */
+
+#define POWER_BUS_MAX_PEERS    15
+#define POWER_BUS_FRAME_LEN    9
+#define POWER_BUS_PERIOD_MS    100
+#define POWER_BUS_PEER_TIMEOUT_MS (5 * POWER_BUS_PERIOD_MS)
+#define POWER_BUS_LISTEN_MS    (2 * POWER_BUS_PERIOD_MS) // Longer than any peer's broadcast interval
+#define POWER_BUS_HOLD_BONUS   32 // Priority kept by a unit already heating, against relay chatter
+
+#define POWER_BUS_SYNC         0xA5
+#define POWER_BUS_FLAG_DEMAND  0x01
+#define POWER_BUS_FLAG_HEATING 0x02
+
+typedef struct PowerBusFrame {
+    uint16_t unit;
+    uint8_t flags;
+    uint8_t priority;
+    uint16_t load_w;
+    uint8_t seq;
+} PowerBusFrame;
+
+typedef struct PowerBusPeer {
+    PowerBusFrame frame;
+    uint32_t heard_ms;
+} PowerBusPeer;
+
+typedef struct PowerBus {
+    PowerBusFrame self;
+    uint32_t budget_w;
+
+    PowerBusPeer peers[POWER_BUS_MAX_PEERS];
+    uint8_t peer_count;
+
+    uint8_t rx[POWER_BUS_FRAME_LEN];
+    uint8_t rx_len;
+
+    uint32_t wait_since_ms; // Start of the current denied demand
+    uint32_t listen_until_ms; // No slot is taken before this
+    uint32_t next_tx_ms;
+
+    uint32_t frames_rx;
+    uint32_t frames_bad;
+} PowerBus;
+
+void power_bus_init(PowerBus *bus, uint16_t unit, uint16_t load_w, uint32_t budget_w, uint32_t now_ms);
+
+/**
+ * Updates this unit's demand.
+ * @param deficit Degrees below setpoint; sets the priority
+ * @param heating Whether the relay is actually on
+ */
+void power_bus_set_demand(PowerBus *bus, bool demand, float deficit, bool heating, uint32_t now_ms);
+
+/* Feeds one received byte; complete valid frames update the peer table */
+void power_bus_receive(PowerBus *bus, uint8_t byte, uint32_t now_ms);
+
+/**
+ * Builds this unit's next broadcast if one is due.
+ * @returns Whether `out` holds a frame to transmit
+ */
+bool power_bus_poll_tx(PowerBus *bus, uint32_t now_ms, uint8_t out[POWER_BUS_FRAME_LEN]);
+
+/**
+ * @returns Whether this unit currently holds a heater slot. Always false
+ * without demand.
+ */
+bool power_bus_may_heat(PowerBus *bus, uint32_t now_ms);
+
+/* @returns Number of peers heard within the timeout */
+int power_bus_active_peers(const PowerBus *bus, uint32_t now_ms);
+
+size_t power_bus_encode(const PowerBusFrame *frame, uint8_t out[POWER_BUS_FRAME_LEN]);
+bool power_bus_decode(const uint8_t in[POWER_BUS_FRAME_LEN], PowerBusFrame *frame);
+
+#endif
@@ -0,0 +1,85 @@
+# Smart Toaster reference build.
+#
+# One KEY = value per line. Values are pasted verbatim into the generated
+# oven_profile.h, so strings need quotes and floats a decimal point.
+# Every key is required; see cmake/oven_profile.cmake for the list.
+
+NAME = "Smart Toaster"
+
+# Pins. SPI_PORT is spi1 and I2C_PORT is i2c0, so these must be pins
+# those instances can be muxed to.
+PIN_MISO      = 12
+PIN_CS        = 13
+PIN_SCK       = 10
+PIN_MOSI      = 11
+I2C_SDA       = 4
+I2C_SCL       = 5
+PIN_RELAY     = 7
+PIN_BTN_MODE  = 16
+PIN_BTN_UP    = 17
+PIN_BTN_DOWN  = 18
+PIN_BTN_START = 19
+PIN_BUZZER    = 20
+
+# Multi-oven power budget bus on uart0 (1 = enabled). Only for units sold
+# to share a circuit; off, the bus pins are left alone. PIN_BUS_DE drives
+# the driver enable of an RS-485 transceiver and can be left unconnected
+# on a plain UART link.
+POWER_BUS          = 0
+PIN_BUS_TX         = 0
+PIN_BUS_RX         = 1
+PIN_BUS_DE         = 2
+# Element rating, and the total every oven on the circuit may draw at once (W)
+ELEMENT_WATTS      = 1500
+POWER_BUS_BUDGET_W = 3000
+
+# Highest cavity temperature the element and probe are rated for (C)
+MAX_TEMP_C = 300
+
+# Toast mode: fixed element temperature, adjustable time (seconds)
+TOAST_TEMP_C       = 260
+TOAST_TIME_DEFAULT = 30
+TOAST_TIME_MIN     = 30
+TOAST_TIME_MAX     = 600
+TOAST_TIME_INC     = 15
+
+# Bake mode: time (seconds) and temperature (Fahrenheit)
+BAKE_TIME_DEFAULT = 300
+BAKE_TIME_MIN     = 30
+BAKE_TIME_MAX     = 1200
+BAKE_TIME_INC     = 30
+BAKE_TEMP_DEFAULT = 82
+BAKE_TEMP_MIN     = 50
+BAKE_TEMP_MAX     = 500
+BAKE_TEMP_INC     = 25
+
+# Bang-bang half band around the target (C)
+TEMP_HYSTERESIS = 2.5
+
+# Optional second MAX6675 on the element, sharing the SPI bus with its own
+# chip select (1 = fitted). With it the relay runs cascade control: PI on
+# the cavity sets an element target, held within ELEMENT_HYSTERESIS. Gains
+# are element degrees per degree of cavity error, and per degree-second.
+ELEMENT_SENSOR     = 0
+PIN_CS_ELEMENT     = 14
+ELEMENT_MAX_TEMP_C = 650
+ELEMENT_HYSTERESIS = 5.0
+CASCADE_KP         = 8.0
+CASCADE_KI         = 0.1
+
+# Two-mass thermal model used by the "mpc" controller. Refit per product
+# from a logged full-power step and the cool-down after it. Heat capacities
+# in J/C, conductances in W/C. The switch penalty trades tracking error for
+# relay wear: 4000 costs as much as a 1C miss held for eight minutes.
+MODEL_ELEMENT_J_PER_C  = 400.0
+MODEL_CAVITY_J_PER_C   = 1500.0
+MODEL_COUPLING_W_PER_C = 6.0
+MODEL_LOSS_W_PER_C     = 3.0
+MPC_SWITCH_PENALTY     = 4000
+
+# Eco controller: cost of heating for one two-second quantum, in the same
+# units as the switch penalty. Higher holds lower and coasts longer at the
+# end of a cycle; 0 leaves eco only its stronger dislike of overshoot.
+# 8000 holds about 1C under target and saves 3-10% against the fixed band
+# in host/control_bench.
+ECO_ENERGY_PENALTY = 8000
@@ -0,0 +1,63 @@
+#include "relay_control.h"
+
+#include <math.h>
+
+void relay_control_init(RelayControl *rc, ControlMode mode, const RelayControlConfig *cfg, float cavity) {
+    *rc = (RelayControl){0};
+    rc->mode = mode;
+    rc->element_max = cfg->element_max;
+    rc->ambient = cfg->ambient;
+    rc->watts = cfg->watts;
+    bang_bang_init(&rc->band, mode == CONTROL_ADAPTIVE_BAND ? CONTROL_ADAPTIVE_BAND : CONTROL_FIXED_BAND,
+                   cfg->hysteresis);
+    cascade_init(&rc->cascade, cfg->cascade_kp, cfg->cascade_ki, cfg->element_max, cfg->element_hysteresis);
+
+    MpcModel model;
+    mpc_model_init(&model, cfg->model_element_j_per_c, cfg->model_cavity_j_per_c,
+                   cfg->model_coupling_w_per_c, cfg->model_loss_w_per_c, cfg->watts);
+    mpc_init(&rc->mpc, &model, cfg->switch_penalty);
+    if (mode == CONTROL_ECO) mpc_set_economy(&rc->mpc, cfg->eco_energy_penalty, ECO_OVER_SHIFT, cfg->hysteresis);
+    relay_control_reset(rc, cavity);
+}
+
+void relay_control_reset(RelayControl *rc, float cavity) {
+    bang_bang_reset(&rc->band);
+    cascade_reset(&rc->cascade);
+    mpc_reset(&rc->mpc, cavity, rc->ambient);
+    rc->mpc_started = false;
+    rc->mpc_planned = false;
+    rc->mpc_demand = false;
+}
+
+bool relay_control_update(RelayControl *rc, uint32_t now_ms, float ref, float ref_rate, float ref_final,
+                          uint32_t remaining_ms, float cavity, float element, float dt_s) {
+    bool demand;
+    rc->mpc_planned = false;
+    if (rc->mode == CONTROL_CASCADE && !isnan(element)) {
+        demand = cascade_update(&rc->cascade, ref, cavity, element, dt_s);
+    } else if (rc->mode == CONTROL_MPC || rc->mode == CONTROL_ECO) {
+        // Plan once per quantum and hold the relay in between
+        if (!rc->mpc_started || (int32_t)(now_ms - rc->mpc_due_ms) >= 0) {
+            rc->mpc_due_ms = (rc->mpc_started ? rc->mpc_due_ms : now_ms) + MPC_QUANTUM_MS;
+            rc->mpc_started = true;
+            rc->mpc_planned = true;
+            rc->mpc_demand = mpc_step(&rc->mpc, cavity, ref, ref_rate, ref_final, remaining_ms);
+        }
+        demand = rc->mpc_demand;
+    } else {
+        demand = bang_bang_update(&rc->band, ref, cavity);
+    }
+    // Whatever the controller, never drive the element past its rating
+    if (element >= rc->element_max) demand = false;
+    return demand;
+}
+
+void relay_control_applied(RelayControl *rc, bool relay_on) {
+    // The model has to predict from what the element actually did
+    if (rc->mode == CONTROL_MPC || rc->mode == CONTROL_ECO) rc->mpc.relay = relay_on;
+}
+
+float relay_control_energy_saved_wh(const RelayControl *rc) {
+    if (rc->mode != CONTROL_ECO) return NAN;
+    return mpc_energy_saved_j(&rc->mpc, rc->watts) / 3600.0f;
+}
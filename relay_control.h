@@ -0,0 +1,82 @@
+#ifndef RELAY_CONTROL_H
+#define RELAY_CONTROL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "control.h"
+#include "mpc.h"
+
+#define ECO_OVER_SHIFT 3 // Eco weights error above the reference 8x
+
+/*
+ * The relay decision made every pass of a running cycle: whichever
+ * controller is selected, with the cascade falling back to the band while
+ * the element sensor isn't reading, the MPC planning once per quantum, and
+ * the element never driven past its rating. Eco is the MPC with economy
+ * on (mpc.h), trading tracking for energy by eco_energy_penalty.
+ *
+ * The firmware's process_cycle and the host benchmark (host/) both run
+ * this, so a controller change can be measured before it is flashed.
+ *
+ * No SDK dependencies. Celsius, seconds and milliseconds throughout.
+ */
+
+typedef struct RelayControlConfig {
+    float hysteresis;         // Cavity half band for the fixed and adaptive modes
+    float element_max;        // Element rating; the relay is held off at or above it
+    float element_hysteresis;
+    float cascade_kp;
+    float cascade_ki;
+    float model_element_j_per_c;
+    float model_cavity_j_per_c;
+    float model_coupling_w_per_c;
+    float model_loss_w_per_c;
+    float watts;
+    uint32_t switch_penalty;
+    uint32_t eco_energy_penalty;
+    float ambient;
+} RelayControlConfig;
+
+typedef struct RelayControl {
+    ControlMode mode;
+    float element_max;
+    float ambient;
+    float watts;
+    BangBang band;     // Fixed or adaptive band; also the cascade's fallback
+    Cascade cascade;
+    Mpc mpc;
+    uint32_t mpc_due_ms;
+    bool mpc_started;  // A plan has been made this cycle, so mpc_due_ms is valid
+    bool mpc_planned;  // The last update planned a quantum
+    bool mpc_demand;   // Held from the last plan until the next
+} RelayControl;
+
+/* Selects a controller, forgetting anything learned */
+void relay_control_init(RelayControl *rc, ControlMode mode, const RelayControlConfig *cfg, float cavity);
+
+/* Starts a new cycle. Learned offsets are kept. */
+void relay_control_reset(RelayControl *rc, float cavity);
+
+/**
+ * Runs one control step.
+ * @param now_ms Monotonic milliseconds; only differences are used
+ * @param ref Cavity reference now; it moves at ref_rate C/s until ref_final
+ * @param remaining_ms Until the cycle ends, or MPC_NO_END while that isn't known
+ * @param element Element reading, NAN when not fitted or not reading
+ * @param dt_s Time since the previous step
+ * @returns Whether the element should heat
+ */
+bool relay_control_update(RelayControl *rc, uint32_t now_ms, float ref, float ref_rate, float ref_final,
+                          uint32_t remaining_ms, float cavity, float element, float dt_s);
+
+/* Reports what the relay did after the power gates, which the MPC predicts from */
+void relay_control_applied(RelayControl *rc, bool relay_on);
+
+/**
+ * Energy eco has saved this cycle against the fixed band.
+ * @returns Watt-hours, NAN unless running eco
+ */
+float relay_control_energy_saved_wh(const RelayControl *rc);
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef STATUS_SNAPSHOT_H
+#define STATUS_SNAPSHOT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Tear-free hand-off of the control loop's state to readers in other
+ * contexts (timer IRQs, the other core, host threads in tooling).
+ *
+ * A sequence lock with one writer: the sequence is odd while a write is in
+ * progress, and a reader keeps a copy only if it saw the same even sequence
+ * before and after. The payload is held in atomic words, so the protocol is
+ * free of data races in the C11 sense. No standalone fences are used, since
+ * ThreadSanitizer doesn't model them.
+ * Only plain loads and stores are used, which the Cortex-M0+ has without
+ * exclusive-access instructions.
+ *
+ * Readers never block the writer. A reader that preempted the writer (an
+ * IRQ on the same core) can never see the write finish, so reads take a
+ * bounded number of attempts and may fail.
+ */
+
+#define CONTROL_STATUS_RUNNING 0x01
+#define CONTROL_STATUS_RELAY   0x02
+
+typedef struct ControlStatus {
+    float temp;             // Celsius
+    int32_t time_target_ms; // Remaining cycle time
+    int16_t temp_target;    // Celsius
+    uint8_t stage;          // heating_stage
+    uint8_t flags;          // CONTROL_STATUS_*
+} ControlStatus;
+
+#define CONTROL_STATUS_WORDS ((sizeof(ControlStatus) + 3) / 4)
+
+typedef struct StatusSnapshot {
+    atomic_uint_least32_t seq;
+    atomic_uint_least32_t words[CONTROL_STATUS_WORDS];
+} StatusSnapshot;
+
+static inline void status_snapshot_init(StatusSnapshot *s) {
+    atomic_init(&s->seq, 0);
+    for (unsigned i = 0; i < CONTROL_STATUS_WORDS; i++) atomic_init(&s->words[i], 0);
+}
+
+/* Single writer only */
+static inline void status_snapshot_publish(StatusSnapshot *s, const ControlStatus *status) {
+    uint32_t words[CONTROL_STATUS_WORDS] = {0};
+    memcpy(words, status, sizeof(*status));
+
+    uint32_t seq = atomic_load_explicit(&s->seq, memory_order_relaxed);
+    atomic_store_explicit(&s->seq, seq + 1, memory_order_relaxed);
+    // Release on each word keeps the odd sequence ahead of it
+    for (unsigned i = 0; i < CONTROL_STATUS_WORDS; i++) {
+        atomic_store_explicit(&s->words[i], words[i], memory_order_release);
+    }
+    atomic_store_explicit(&s->seq, seq + 2, memory_order_release);
+}
+
+/**
+ * Copies a consistent snapshot.
+ * @param attempts Tries before giving up; use 1 from an IRQ that can preempt the writer
+ * @returns false if every attempt overlapped a write
+ */
+static inline bool status_snapshot_read(StatusSnapshot *s, ControlStatus *out, int attempts) {
+    uint32_t words[CONTROL_STATUS_WORDS];
+    while (attempts-- > 0) {
+        uint32_t before = atomic_load_explicit(&s->seq, memory_order_acquire);
+        if (before & 1) continue;
+        // Acquire on each word keeps the second sequence load after it
+        for (unsigned i = 0; i < CONTROL_STATUS_WORDS; i++) {
+            words[i] = atomic_load_explicit(&s->words[i], memory_order_acquire);
+        }
+        if (atomic_load_explicit(&s->seq, memory_order_relaxed) == before) {
+            memcpy(out, words, sizeof(*out));
+            return true;
+        }
+    }
+    return false;
+}
+
+#endif
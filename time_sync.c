@@ -0,0 +1,85 @@
+#include "time_sync.h"
+
+#include <string.h>
+
+void time_sync_init(TimeSync *ts) {
+    memset(ts, 0, sizeof(*ts));
+}
+
+void time_sync_ping(TimeSync *ts, int64_t host_send_us, uint64_t local_us) {
+    ts->ping_wall_us = host_send_us;
+    ts->ping_local_us = local_us;
+    ts->ping_pending = true;
+}
+
+/* Unix time at local_us from the reference and the drift estimate */
+static int64_t predict(const TimeSync *ts, uint64_t local_us) {
+    int64_t elapsed = (int64_t)(local_us - ts->ref_local_us);
+    return ts->ref_wall_us + elapsed + elapsed * ts->drift_ppb / 1000000000LL;
+}
+
+/* Called with the best sample of each finished burst */
+static void update_drift(TimeSync *ts, uint64_t local_us, int64_t wall_us) {
+    int64_t span = (int64_t)(local_us - ts->anchor_local_us);
+    if (ts->anchor_valid && span < TIME_SYNC_DRIFT_SPAN_US) return;
+
+    int64_t error = (wall_us - ts->anchor_wall_us) - span;
+    bool plausible = ts->anchor_valid && error <= span / 1000 && error >= -span / 1000; // Also keeps the multiply in range
+    int64_t ppb = plausible ? error * 1000000000LL / span : 0;
+    ts->anchor_local_us = local_us;
+    ts->anchor_wall_us = wall_us;
+    // Implausible rates mean the host clock stepped; start over from here
+    if (!plausible || ppb > TIME_SYNC_MAX_DRIFT_PPB || ppb < -TIME_SYNC_MAX_DRIFT_PPB) {
+        ts->anchor_valid = true;
+        return;
+    }
+
+    // First estimate is taken as is; later ones are smoothed, since each
+    // carries the round-trip error of two samples
+    if (ts->drift_valid) ppb = ts->drift_ppb + (ppb - ts->drift_ppb) / 4;
+    ts->drift_ppb = (int32_t)ppb;
+    ts->drift_valid = true;
+}
+
+bool time_sync_complete(TimeSync *ts, int64_t host_send_us, int64_t host_recv_us) {
+    if (!ts->ping_pending || host_send_us != ts->ping_wall_us) return false;
+    ts->ping_pending = false;
+
+    int64_t rtt = host_recv_us - host_send_us;
+    if (rtt < 0 || rtt > TIME_SYNC_MAX_RTT_US) {
+        ts->rejected++;
+        return false;
+    }
+
+    uint64_t local_us = ts->ping_local_us;
+    int64_t wall_us = host_send_us + rtt / 2;
+    ts->samples++;
+
+    if (ts->valid && (int64_t)(local_us - ts->ref_local_us) < TIME_SYNC_BURST_US) {
+        // Same burst: keep whichever sample had the tighter bound
+        if ((uint32_t)rtt >= ts->ref_rtt_us) return false;
+    } else if (ts->valid) {
+        // New burst: the previous one is final, so measure drift with it
+        update_drift(ts, ts->ref_local_us, ts->ref_wall_us);
+    }
+
+    ts->ref_local_us = local_us;
+    ts->ref_wall_us = wall_us;
+    ts->ref_rtt_us = (uint32_t)rtt;
+    ts->valid = true;
+    return true;
+}
+
+bool time_sync_wall_us(const TimeSync *ts, uint64_t local_us, int64_t *wall_us) {
+    if (!ts->valid) return false;
+    *wall_us = predict(ts, local_us);
+    return true;
+}
+
+bool time_sync_due(TimeSync *ts, uint64_t local_us) {
+    bool stale = !ts->valid || (int64_t)(local_us - ts->ref_local_us) >= TIME_SYNC_RESYNC_US;
+    if (!stale) return false;
+    if (ts->last_request_us && (int64_t)(local_us - ts->last_request_us) < TIME_SYNC_RESYNC_US) return false;
+    ts->last_request_us = local_us;
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Wall-clock time from host pings over the USB console.
+ *
+ *   host -> "sync <t1>"      t1: host Unix time in us when sent
+ *   dev  -> "SYNC <t1> <t2>" t2: device time since boot in us on receipt
+ *   host -> "time <t1> <t4>" t4: host Unix time in us when SYNC arrived
+ *
+ * The device was at t2 somewhere between t1 and t4, so the midpoint is taken
+ * with an error of at most half the round trip. Within a burst of pings the
+ * lowest round trip wins. References from bursts at least
+ * TIME_SYNC_DRIFT_SPAN_US apart give the local oscillator's rate error,
+ * which is applied between syncs. The device asks for a new burst with
+ * "TIME?" once the reference is TIME_SYNC_RESYNC_US old.
+ *
+ * No SDK dependencies: the caller supplies the local microsecond clock.
+ */
+
+#define TIME_SYNC_MAX_RTT_US    50000
+#define TIME_SYNC_BURST_US      10000000LL
+#define TIME_SYNC_DRIFT_SPAN_US 60000000LL
+#define TIME_SYNC_RESYNC_US     (15 * 60 * 1000000LL)
+#define TIME_SYNC_MAX_DRIFT_PPB 500000 // Crystal error can't plausibly exceed 500 ppm
+
+typedef struct TimeSync {
+    bool valid;
+    uint64_t ref_local_us; // Device time of the reference
+    int64_t ref_wall_us;   // Unix time at ref_local_us
+    uint32_t ref_rtt_us;
+
+    bool anchor_valid;
+    uint64_t anchor_local_us; // Best sample of an earlier burst, for drift
+    int64_t anchor_wall_us;
+    bool drift_valid;
+    int32_t drift_ppb;        // Wall clock runs this much faster than local
+
+    int64_t ping_wall_us;     // t1 of the outstanding ping
+    uint64_t ping_local_us;   // t2 of the outstanding ping
+    bool ping_pending;
+
+    uint64_t last_request_us;
+    uint32_t samples;
+    uint32_t rejected;
+} TimeSync;
+
+void time_sync_init(TimeSync *ts);
+
+/* Records a host ping (t1) received at local time t2 */
+void time_sync_ping(TimeSync *ts, int64_t host_send_us, uint64_t local_us);
+
+/**
+ * Completes the outstanding ping with the host's receive time.
+ * @returns Whether the sample was used
+ */
+bool time_sync_complete(TimeSync *ts, int64_t host_send_us, int64_t host_recv_us);
+
+/**
+ * Converts local time to Unix time, applying the drift estimate.
+ * @returns false if never synced
+ */
+bool time_sync_wall_us(const TimeSync *ts, uint64_t local_us, int64_t *wall_us);
+
+/**
+ * Rate-limited resync request.
+ * @returns Whether the caller should ask the host for a new burst now
+ */
+bool time_sync_due(TimeSync *ts, uint64_t local_us);
+
+#endif
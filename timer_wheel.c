@@ -0,0 +1,150 @@
+#include "timer_wheel.h"
+
+#include <string.h>
+
+// First slot index and bit shift of each level
+#define LEVEL_BASE(level)  ((level) == 0 ? 0 : TIMER_WHEEL_L0_SLOTS + ((level) - 1) * TIMER_WHEEL_LN_SLOTS)
+#define LEVEL_SHIFT(level) ((level) == 0 ? 0 : TIMER_WHEEL_L0_BITS + ((level) - 1) * TIMER_WHEEL_LN_BITS)
+#define LEVEL_SLOTS(level) ((level) == 0 ? TIMER_WHEEL_L0_SLOTS : TIMER_WHEEL_LN_SLOTS)
+
+void timer_wheel_init(TimerWheel *w, uint32_t now_ms) {
+    memset(w, 0, sizeof(*w));
+    w->tick_ms = now_ms;
+}
+
+/* Links e into the slot its expiry falls in, counted from the wheel's tick */
+static void place(TimerWheel *w, TimerWheelEntry *e) {
+    uint32_t expires = e->expires_ms;
+    uint32_t delta = expires - w->tick_ms;
+    if ((int32_t)delta < 0) {
+        // Already due; runs on the next tick
+        expires = w->tick_ms;
+        delta = 0;
+    } else if (delta > TIMER_WHEEL_SPAN_MS) {
+        // Waits in the furthest slot and is placed again from there
+        expires = w->tick_ms + TIMER_WHEEL_SPAN_MS;
+        delta = TIMER_WHEEL_SPAN_MS;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= 1u << LEVEL_SHIFT(level + 1)) level++;
+    uint16_t slot = (uint16_t)(LEVEL_BASE(level) + ((expires >> LEVEL_SHIFT(level)) & (LEVEL_SLOTS(level) - 1)));
+
+    e->slot = slot;
+    e->next = w->slots[slot];
+    if (e->next) e->next->pprev = &e->next;
+    e->pprev = &w->slots[slot];
+    w->slots[slot] = e;
+    w->occupied[slot / 32] |= 1u << (slot % 32);
+}
+
+/* Takes e off whichever list it is on, a slot or a list being run */
+static void detach(TimerWheel *w, TimerWheelEntry *e) {
+    *e->pprev = e->next;
+    if (e->next) e->next->pprev = e->pprev;
+    e->pprev = NULL;
+    if (!w->slots[e->slot]) w->occupied[e->slot / 32] &= ~(1u << (e->slot % 32));
+}
+
+void timer_wheel_start(TimerWheel *w, TimerWheelEntry *e, uint32_t now_ms, uint32_t delay_ms, uint32_t period_ms,
+                       TimerWheelCallback callback, void *arg) {
+    if (timer_wheel_pending(e)) {
+        detach(w, e);
+    } else {
+        w->active++;
+    }
+    e->expires_ms = now_ms + delay_ms;
+    e->period_ms = period_ms;
+    e->callback = callback;
+    e->arg = arg;
+    place(w, e);
+}
+
+void timer_wheel_cancel(TimerWheel *w, TimerWheelEntry *e) {
+    if (!timer_wheel_pending(e)) return;
+    detach(w, e);
+    w->active--;
+}
+
+/* Distance from start to the first occupied slot of a level, wrapping; -1 if none */
+static int scan(const TimerWheel *w, int level, uint32_t start) {
+    // Levels start on a word boundary and are whole words long
+    uint32_t n = LEVEL_SLOTS(level);
+    for (uint32_t i = 0; i < n;) {
+        uint32_t s = (start + i) % n;
+        uint32_t word = w->occupied[(LEVEL_BASE(level) + s) / 32] >> (s % 32);
+        if (word) return (int)(i + (uint32_t)__builtin_ctz(word));
+        i += 32 - s % 32;
+    }
+    return -1;
+}
+
+bool timer_wheel_next(const TimerWheel *w, uint32_t *at_ms) {
+    if (w->active == 0) return false;
+
+    int d = scan(w, 0, w->tick_ms & (TIMER_WHEEL_L0_SLOTS - 1));
+    uint32_t best = d >= 0 ? (uint32_t)d : UINT32_MAX;
+    for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        // A slot above level 0 is run when the tick reaches its start
+        uint32_t shift = LEVEL_SHIFT(level);
+        uint32_t first = (w->tick_ms >> shift) + ((w->tick_ms & ((1u << shift) - 1)) != 0);
+        d = scan(w, level, first & (TIMER_WHEEL_LN_SLOTS - 1));
+        if (d >= 0) {
+            uint32_t at = (first + (uint32_t)d) << shift;
+            if (at - w->tick_ms < best) best = at - w->tick_ms;
+        }
+    }
+    *at_ms = w->tick_ms + best;
+    return true;
+}
+
+/* Moves a slot's entries down now that the tick has reached its start */
+static void cascade(TimerWheel *w, int level) {
+    uint16_t slot = (uint16_t)(LEVEL_BASE(level) + ((w->tick_ms >> LEVEL_SHIFT(level)) & (TIMER_WHEEL_LN_SLOTS - 1)));
+    TimerWheelEntry *e = w->slots[slot];
+    w->slots[slot] = NULL;
+    w->occupied[slot / 32] &= ~(1u << (slot % 32));
+    while (e) {
+        TimerWheelEntry *next = e->next;
+        place(w, e);
+        w->cascaded++;
+        e = next;
+    }
+}
+
+uint32_t timer_wheel_run(TimerWheel *w, uint32_t now_ms) {
+    uint32_t fired = 0;
+    uint32_t at;
+    while (timer_wheel_next(w, &at) && (int32_t)(at - now_ms) <= 0) {
+        w->tick_ms = at;
+        for (int level = 1; level < TIMER_WHEEL_LEVELS && (at & ((1u << LEVEL_SHIFT(level)) - 1)) == 0; level++) {
+            cascade(w, level);
+        }
+
+        // Run the slot from a list of its own, so callbacks can start timers
+        // for this same tick without being run again until the next
+        uint16_t slot = (uint16_t)(at & (TIMER_WHEEL_L0_SLOTS - 1));
+        TimerWheelEntry *due = w->slots[slot];
+        w->slots[slot] = NULL;
+        w->occupied[slot / 32] &= ~(1u << (slot % 32));
+        if (due) due->pprev = &due;
+        w->tick_ms = at + 1;
+
+        while (due) {
+            TimerWheelEntry *e = due;
+            detach(w, e);
+            if (e->period_ms) {
+                e->expires_ms += e->period_ms;
+                if ((int32_t)(e->expires_ms - now_ms) <= 0) e->expires_ms = now_ms + e->period_ms;
+                place(w, e);
+            } else {
+                w->active--;
+            }
+            w->fired++;
+            fired++;
+            if (e->callback) e->callback(e, e->arg);
+        }
+    }
+    if ((int32_t)(now_ms + 1 - w->tick_ms) > 0) w->tick_ms = now_ms + 1;
+    return fired;
+}
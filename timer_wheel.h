@@ -0,0 +1,92 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Hierarchical timer wheel for one-shot and periodic millisecond timeouts.
+ *
+ * Level 0 has a slot for each of the next 256 ms. Each level above has 64
+ * slots, a slot spanning a whole turn of the level below, so four levels
+ * reach 2^26 ms (about 18 hours); anything longer waits in the top level
+ * and is placed again as it comes round. A timer is an entry owned by the
+ * caller and linked into one slot, so starting and cancelling are O(1)
+ * with no allocation. When a slot above level 0 comes due its entries move
+ * down, at most once per level over a timer's life.
+ *
+ * A bitmap of occupied slots lets timer_wheel_next say how long the caller
+ * may sleep, and timer_wheel_run jump over empty time instead of stepping
+ * through it.
+ *
+ * No SDK dependencies: the caller supplies the millisecond clock and runs
+ * the wheel and its callbacks from one context.
+ */
+
+#define TIMER_WHEEL_L0_BITS 8
+#define TIMER_WHEEL_LN_BITS 6
+#define TIMER_WHEEL_LEVELS  4
+#define TIMER_WHEEL_L0_SLOTS (1u << TIMER_WHEEL_L0_BITS)
+#define TIMER_WHEEL_LN_SLOTS (1u << TIMER_WHEEL_LN_BITS)
+#define TIMER_WHEEL_SLOTS    (TIMER_WHEEL_L0_SLOTS + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_LN_SLOTS)
+#define TIMER_WHEEL_SPAN_MS  ((1u << (TIMER_WHEEL_L0_BITS + (TIMER_WHEEL_LEVELS - 1) * TIMER_WHEEL_LN_BITS)) - 1)
+
+typedef struct TimerWheelEntry TimerWheelEntry;
+
+/*
+ * Runs when e falls due. A periodic e has already been started again. May
+ * be NULL for a deadline that is only checked with timer_wheel_pending.
+ */
+typedef void (*TimerWheelCallback)(TimerWheelEntry *e, void *arg);
+
+struct TimerWheelEntry {
+    TimerWheelEntry *next;
+    TimerWheelEntry **pprev; // Link pointing at this entry, NULL while not pending
+    uint16_t slot;
+    uint32_t expires_ms;
+    uint32_t period_ms;      // 0 for a one-shot
+    TimerWheelCallback callback;
+    void *arg;
+};
+
+typedef struct TimerWheel {
+    uint32_t tick_ms;        // Next millisecond to run
+    TimerWheelEntry *slots[TIMER_WHEEL_SLOTS];
+    uint32_t occupied[TIMER_WHEEL_SLOTS / 32];
+    uint32_t active;         // Pending entries
+    uint32_t fired;          // Callbacks run
+    uint32_t cascaded;       // Entries moved down a level
+} TimerWheel;
+
+void timer_wheel_init(TimerWheel *w, uint32_t now_ms);
+
+/**
+ * Starts e, or restarts it if it is pending.
+ * @param delay_ms From now_ms until the first call. Time already run doesn't
+ *                 run again, so 0 right after timer_wheel_run(now_ms) waits
+ *                 for the next millisecond.
+ * @param period_ms Between later calls, 0 for a one-shot. Periods missed
+ *                  while the wheel wasn't run are skipped, not made up.
+ */
+void timer_wheel_start(TimerWheel *w, TimerWheelEntry *e, uint32_t now_ms, uint32_t delay_ms, uint32_t period_ms,
+                       TimerWheelCallback callback, void *arg);
+
+/* Stops e if it is pending */
+void timer_wheel_cancel(TimerWheel *w, TimerWheelEntry *e);
+
+static inline bool timer_wheel_pending(const TimerWheelEntry *e) { return e->pprev != 0; }
+
+/**
+ * Finds when the wheel next has work: a timer falling due or a slot above
+ * level 0 moving down, which may be before the timers in it are due.
+ * @returns Whether any timer is pending; *at_ms is only set if so
+ */
+bool timer_wheel_next(const TimerWheel *w, uint32_t *at_ms);
+
+/**
+ * Runs every timer due at or before now_ms, in deadline order.
+ * @returns Callbacks run
+ */
+uint32_t timer_wheel_run(TimerWheel *w, uint32_t now_ms);
+
+#endif
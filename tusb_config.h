@@ -0,0 +1,26 @@
+#ifndef TUSB_CONFIG_H
+#define TUSB_CONFIG_H
+
+// TinyUSB configuration for the USB_MSC_EXPORT build: CDC for stdio plus
+// one mass-storage LUN. CFG_TUSB_MCU is set by the Pico SDK.
+
+#ifndef CFG_TUSB_OS
+#define CFG_TUSB_OS OPT_OS_PICO
+#endif
+
+#define CFG_TUSB_RHPORT0_MODE  OPT_MODE_DEVICE
+#define CFG_TUD_ENDPOINT0_SIZE 64
+
+#define CFG_TUD_CDC    1
+#define CFG_TUD_MSC    1
+#define CFG_TUD_HID    0
+#define CFG_TUD_MIDI   0
+#define CFG_TUD_VENDOR 0
+
+#define CFG_TUD_CDC_RX_BUFSIZE 256
+#define CFG_TUD_CDC_TX_BUFSIZE 256
+
+// One full-speed transfer window of sectors per read10 callback
+#define CFG_TUD_MSC_EP_BUFSIZE 4096
+
+#endif
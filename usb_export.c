@@ -0,0 +1,291 @@
+#include "usb_export.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+/*
+ * Synthetic read-only FAT12 volume. Nothing is staged: every sector the host
+ * asks for is rendered straight into TinyUSB's transfer buffer.
+ *
+ * Layout, one sector per cluster:
+ *   0               boot sector
+ *   1               FAT (a single copy; 256 clusters fit one sector)
+ *   2               root directory (16 entries)
+ *   3...            data, with each file given a fixed run of clusters
+ *                   sized for a full cycle log
+ */
+
+#define SECTOR_SIZE   512
+#define DISK_SECTORS  256
+#define FAT_SECTOR    1
+#define ROOT_SECTOR   2
+#define DATA_SECTOR   3
+#define ROOT_ENTRIES  (SECTOR_SIZE / 32)
+
+// CSV rows are padded to a fixed width so any byte offset maps to a row.
+// The header is longer than a row and fills the first sector on its own.
+#define CSV_ROW_LEN   128
+#define CSV_ROWS_PER_SECTOR (SECTOR_SIZE / CSV_ROW_LEN)
+#define TRACE_SLOTS_PER_SECTOR (SECTOR_SIZE / sizeof(CycleLogRecord))
+
+// Upper bound on records, used to reserve each file's clusters
+#define EXPORT_MAX_RECORDS 512
+
+enum { FILE_CSV, FILE_TRACE, FILE_SETTINGS, FILE_COUNT };
+
+#define CSV_CLUSTERS      (1 + (EXPORT_MAX_RECORDS + CSV_ROWS_PER_SECTOR - 1) / CSV_ROWS_PER_SECTOR)
+#define TRACE_CLUSTERS    ((EXPORT_MAX_RECORDS + 1 + TRACE_SLOTS_PER_SECTOR - 1) / TRACE_SLOTS_PER_SECTOR)
+#define SETTINGS_CLUSTERS 1
+
+static const uint16_t file_first_cluster[FILE_COUNT] = {
+    2, 2 + CSV_CLUSTERS, 2 + CSV_CLUSTERS + TRACE_CLUSTERS
+};
+static const uint16_t file_max_clusters[FILE_COUNT] = {CSV_CLUSTERS, TRACE_CLUSTERS, SETTINGS_CLUSTERS};
+static const char file_names[FILE_COUNT][11] = {"CYCLES  CSV", "TRACE   BIN", "SETTINGSTXT"};
+
+_Static_assert(DATA_SECTOR + CSV_CLUSTERS + TRACE_CLUSTERS + SETTINGS_CLUSTERS <= DISK_SECTORS, "Files exceed the volume");
+_Static_assert(DISK_SECTORS * 3 / 2 <= SECTOR_SIZE, "FAT must fit one sector");
+_Static_assert(sizeof(CYCLE_LOG_CSV_HEADER) <= SECTOR_SIZE, "CSV header must fit its sector");
+
+static uint32_t export_records(void) {
+    uint32_t n = export_cycle_count();
+    return n > EXPORT_MAX_RECORDS ? EXPORT_MAX_RECORDS : n;
+}
+
+/* Records skipped so the newest EXPORT_MAX_RECORDS are exported */
+static uint32_t export_first(void) {
+    uint32_t n = export_cycle_count();
+    return n > EXPORT_MAX_RECORDS ? n - EXPORT_MAX_RECORDS : 0;
+}
+
+static uint32_t file_size(int file) {
+    char buf[SECTOR_SIZE];
+    switch (file) {
+        case FILE_CSV: return SECTOR_SIZE + export_records() * CSV_ROW_LEN;
+        case FILE_TRACE: return (export_records() + 1) * sizeof(CycleLogRecord);
+        default: return (uint32_t)export_settings_text(buf, sizeof(buf));
+    }
+}
+
+static uint16_t file_clusters(int file) {
+    uint32_t n = (file_size(file) + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    return (uint16_t)(n > file_max_clusters[file] ? file_max_clusters[file] : n);
+}
+
+static void put16(uint8_t *p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put32(uint8_t *p, uint32_t v) { put16(p, (uint16_t)v); put16(p + 2, (uint16_t)(v >> 16)); }
+
+static void render_boot_sector(uint8_t *b) {
+    static const uint8_t jump[3] = {0xEB, 0x3C, 0x90};
+    memcpy(b, jump, 3);
+    memcpy(b + 3, "MSWIN4.1", 8);
+    put16(b + 11, SECTOR_SIZE);
+    b[13] = 1;                  // Sectors per cluster
+    put16(b + 14, FAT_SECTOR);  // Reserved sectors
+    b[16] = 1;                  // FAT copies
+    put16(b + 17, ROOT_ENTRIES);
+    put16(b + 19, DISK_SECTORS);
+    b[21] = 0xF8;               // Fixed media
+    put16(b + 22, 1);           // Sectors per FAT
+    put16(b + 24, 1);           // Sectors per track
+    put16(b + 26, 1);           // Heads
+    b[36] = 0x80;               // Drive number
+    b[38] = 0x29;               // Extended boot signature
+    put32(b + 39, 0x70A57E12);  // Volume serial
+    memcpy(b + 43, "TOASTER LOG", 11);
+    memcpy(b + 54, "FAT12   ", 8);
+    b[510] = 0x55;
+    b[511] = 0xAA;
+}
+
+static void fat12_set(uint8_t *fat, uint16_t cluster, uint16_t value) {
+    uint8_t *p = fat + cluster * 3 / 2;
+    if (cluster & 1) {
+        p[0] = (uint8_t)((p[0] & 0x0F) | (value << 4));
+        p[1] = (uint8_t)(value >> 4);
+    } else {
+        p[0] = (uint8_t)value;
+        p[1] = (uint8_t)((p[1] & 0xF0) | ((value >> 8) & 0x0F));
+    }
+}
+
+/* Each file is one contiguous chain over the clusters it currently uses */
+static void render_fat(uint8_t *b) {
+    fat12_set(b, 0, 0xFF8);
+    fat12_set(b, 1, 0xFFF);
+    for (int f = 0; f < FILE_COUNT; f++) {
+        uint16_t first = file_first_cluster[f];
+        uint16_t n = file_clusters(f);
+        for (uint16_t i = 0; i < n; i++) {
+            fat12_set(b, first + i, i + 1 < n ? first + i + 1 : 0xFFF);
+        }
+    }
+}
+
+static void render_root(uint8_t *b) {
+    memcpy(b, "TOASTER LOG", 11);
+    b[11] = 0x08; // Volume label
+
+    for (int f = 0; f < FILE_COUNT; f++) {
+        uint8_t *e = b + 32 * (f + 1);
+        memcpy(e, file_names[f], 11);
+        e[11] = 0x01;             // Read-only
+        put16(e + 24, (uint16_t)(((2025 - 1980) << 9) | (1 << 5) | 1)); // Modified 2025-01-01
+        put16(e + 26, file_first_cluster[f]);
+        put32(e + 28, file_size(f));
+    }
+}
+
+static void render_csv(uint8_t *b, uint32_t sector) {
+    if (sector == 0) {
+        int n = snprintf((char *)b, SECTOR_SIZE, "%s", CYCLE_LOG_CSV_HEADER);
+        memset(b + n, ' ', SECTOR_SIZE - 1 - n);
+        b[SECTOR_SIZE - 1] = '\n';
+        return;
+    }
+
+    for (uint32_t i = 0; i < CSV_ROWS_PER_SECTOR; i++) {
+        char *row = (char *)b + i * CSV_ROW_LEN;
+        uint32_t index = (sector - 1) * CSV_ROWS_PER_SECTOR + i;
+        int n = 0;
+
+        if (index < export_records()) {
+            const CycleLogRecord *r = export_cycle_record(export_first() + index);
+            if (cycle_log_record_valid(r)) n = cycle_log_format_csv(r, row, CSV_ROW_LEN);
+        } else {
+            break; // Past the end of the file; the host ignores the rest
+        }
+
+        // Pad with spaces so every row is exactly CSV_ROW_LEN bytes
+        if (n < 0) n = 0;
+        if (n > CSV_ROW_LEN - 1) n = CSV_ROW_LEN - 1;
+        memset(row + n, ' ', CSV_ROW_LEN - 1 - n);
+        row[CSV_ROW_LEN - 1] = '\n';
+    }
+}
+
+static void render_trace(uint8_t *b, uint32_t sector) {
+    for (uint32_t i = 0; i < TRACE_SLOTS_PER_SECTOR; i++) {
+        uint8_t *slot = b + i * sizeof(CycleLogRecord);
+        uint32_t index = sector * TRACE_SLOTS_PER_SECTOR + i;
+
+        if (index == 0) {
+            CycleLogHeader h;
+            export_trace_header(&h);
+            h.count = export_records();
+            memcpy(slot, &h, sizeof(h));
+        } else if (index <= export_records()) {
+            // Straight out of XIP flash
+            memcpy(slot, export_cycle_record(export_first() + index - 1), sizeof(CycleLogRecord));
+        }
+    }
+}
+
+static void render_sector(uint8_t *b, uint32_t lba) {
+    memset(b, 0, SECTOR_SIZE);
+    if (lba == 0) {
+        render_boot_sector(b);
+    } else if (lba == FAT_SECTOR) {
+        render_fat(b);
+    } else if (lba == ROOT_SECTOR) {
+        render_root(b);
+    } else if (lba >= DATA_SECTOR) {
+        uint16_t cluster = (uint16_t)(lba - DATA_SECTOR + 2);
+        for (int f = 0; f < FILE_COUNT; f++) {
+            if (cluster < file_first_cluster[f] || cluster >= file_first_cluster[f] + file_max_clusters[f]) continue;
+            uint32_t sector = cluster - file_first_cluster[f];
+            if (f == FILE_CSV) render_csv(b, sector);
+            else if (f == FILE_TRACE) render_trace(b, sector);
+            else export_settings_text((char *)b, SECTOR_SIZE);
+        }
+    }
+}
+
+/* --- TinyUSB MSC callbacks --- */
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4]) {
+    (void)lun;
+    memcpy(vendor_id, "Toaster ", 8);
+    memcpy(product_id, "Cycle Logs      ", 16);
+    memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun) {
+    (void)lun;
+    return true;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size) {
+    (void)lun;
+    *block_count = DISK_SECTORS;
+    *block_size = SECTOR_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject) {
+    (void)lun;
+    (void)power_condition;
+    (void)start;
+    (void)load_eject;
+    return true;
+}
+
+bool tud_msc_is_writable_cb(uint8_t lun) {
+    (void)lun;
+    return false;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize) {
+    (void)lun;
+    uint8_t *out = buffer;
+    uint32_t done = 0;
+    uint8_t sector[SECTOR_SIZE];
+
+    while (done < bufsize && lba < DISK_SECTORS) {
+        uint32_t n = SECTOR_SIZE - offset;
+        if (n > bufsize - done) n = bufsize - done;
+
+        if (offset == 0 && n == SECTOR_SIZE) {
+            render_sector(out + done, lba);
+        } else {
+            // Partial sector; only happens with unusual transfer sizes
+            render_sector(sector, lba);
+            memcpy(out + done, sector + offset, n);
+        }
+        done += n;
+        offset = 0;
+        lba++;
+    }
+    return (int32_t)done;
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize) {
+    (void)lun;
+    (void)lba;
+    (void)offset;
+    (void)buffer;
+    (void)bufsize;
+    return -1;
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize) {
+    (void)buffer;
+    (void)bufsize;
+    switch (scsi_cmd[0]) {
+        case SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL:
+            return 0;
+        default:
+            tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+            return -1;
+    }
+}
+
+/* --- Service --- */
+void usb_export_init(void) {
+    tud_init(BOARD_TUD_RHPORT);
+}
+
+void usb_export_task(void) {
+    tud_task();
+}
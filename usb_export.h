@@ -0,0 +1,32 @@
+#ifndef USB_EXPORT_H
+#define USB_EXPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "cycle_log.h"
+
+/*
+ * Optional USB mass-storage export (USB_MSC_EXPORT build option). The device
+ * enumerates as CDC serial plus a read-only FAT12 drive whose files are
+ * rendered sector by sector from the flash logs as the host reads them:
+ *
+ *   CYCLES.CSV    one fixed-width row per logged cycle
+ *   TRACE.BIN     CycleLogHeader followed by the raw CycleLogRecords
+ *   SETTINGS.TXT  profile limits and current settings
+ */
+
+/* --- Provided by the application --- */
+uint32_t export_cycle_count(void);
+const CycleLogRecord *export_cycle_record(uint32_t index); // Oldest first
+void export_trace_header(CycleLogHeader *header);
+size_t export_settings_text(char *buf, size_t len);
+
+/* --- Provided by usb_export.c --- */
+// Brings up TinyUSB. Must run before stdio_init_all().
+void usb_export_init(void);
+
+// Services USB transfers that have arrived; the main loop calls it on every wake
+void usb_export_task(void);
+
+#endif